@@ -1,11 +1,25 @@
+//clock_gettime and CLOCK_MONOTONIC (GC pause timing) are POSIX, not C99
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define DYNC_THREAD_LOCAL _Thread_local
+#else
+#define DYNC_THREAD_LOCAL __thread
+#endif
 
 typedef struct Object object_t;
 void object_free(object_t *obj);
+bool object_equals(object_t *a, object_t *b);
 
 //Enum for kind
 typedef enum {
@@ -14,17 +28,41 @@ typedef enum {
     STRING,
     COLLECTION,
     VECTOR,
+    MATRIX,
+    VECTOR_EXPR, //deferred element-wise vector expression, only ever on a lazy VM's stack
+    DICT, //hash map from any non-DICT object to any object
+    SET, //hash set, a DICT table without values
+    DEQUE, //double-ended queue on a ring buffer
+    PLIST, //persistent list, every change makes a new version sharing structure with the old one
 } object_kind_t;
 
 
+//How a collection stores its items, see collection_item
+typedef enum {
+    ITEMS_BOXED, //object_t pointers
+    ITEMS_INT, //packed int32_t values, INTEGER items only
+    ITEMS_FLOAT //packed float values, FLOAT items only
+} collection_items_t;
+
 //Struct definition for collection kind
 typedef struct{
     size_t  length; //count of objects in collection
-    object_t **data; //array of object_t pointers to hold objects in the collection
-    size_t capacity; //Capacity(in bytes) of the collection
+    object_t **data; //array of object_t pointers to hold objects in the collection, or packed values (see items)
+    size_t capacity; //Capacity(in items) of the collection
     bool stack;  //Identifier if collection is a stack or a normal collection
+    uint8_t items; //collection_items_t
 } collection;
 
+typedef struct rope_node rope_node_t;
+
+//Struct definition for string kind
+typedef struct {
+    size_t length; //bytes, not counting the null terminator
+    size_t capacity; //bytes chars can hold, not counting the null terminator
+    char *chars; //null terminated, points right behind the object for short strings. NULL while a rope. Into the base, unterminated, for a view
+    rope_node_t *rope; //concatenation tree holding the bytes instead of chars, see string_flatten
+} string;
+
 //Struct definition for vector kind
 typedef struct {
     size_t dimensions; //
@@ -34,22 +72,181 @@ typedef struct {
 
 
 
-//Union to hold different data types(primitives, strings, collections and vectors)
+//Struct definition for matrix kind
+typedef struct {
+    size_t rows;
+    size_t cols;
+    float *values; //rows * cols floats, row-major: element (i, j) is values[i * cols + j]
+} matrix;
+
+//Struct definition for a deferred vector expression node: left (op) right
+typedef struct {
+    int op; //arith_op_t
+    size_t dimensions;
+    size_t nodes; //VECTOR_EXPR nodes in this tree, this one included
+    object_t *left; //VECTOR or VECTOR_EXPR, owned
+    object_t *right; //VECTOR, VECTOR_EXPR, INTEGER or FLOAT, owned
+} vector_expr;
+
+//One slot of a dict's open-addressing table
+typedef struct {
+    object_t *key; //owned, NULL for an empty slot
+    object_t *value; //owned
+    uint32_t hash; //low 32 bits of object_hash(key)
+    uint32_t probe; //distance from the key's home slot
+} dict_slot_t;
+
+//Struct definition for dict kind, also used by SET (every value NULL)
+typedef struct {
+    size_t length; //keys stored
+    size_t capacity; //slots, a power of two
+    dict_slot_t *slots;
+} dict;
+
+//Struct definition for deque kind
+typedef struct {
+    size_t head; //slot of the front item
+    size_t length; //items stored
+    size_t capacity; //slots, a power of two
+    object_t **items; //ring of owned items, item i lives in slot (head + i) & (capacity - 1)
+} deque;
+
+typedef struct plist_node plist_node_t;
+
+//Struct definition for persistent list kind
+typedef struct {
+    size_t length;
+    plist_node_t *root; //balanced tree of item chunks, NULL when empty
+} plist;
+
+//Union to hold different data types(primitives, strings, collections, vectors and matrices)
 typedef union {
     int v_int;
     float v_float;
-    char * v_string;
+    string v_string;
     collection v_collection;
     vector v_vector;
+    matrix v_matrix;
+    vector_expr v_expr;
+    dict v_dict;
+    deque v_deque;
+    plist v_plist;
 } object_data_t;
 
 
 //Struct definition for the actual object
 typedef struct Object{
-    object_kind_t kind;
+    uint8_t kind; //object_kind_t, a byte so flags and refcount fit in the header padding
+    uint8_t flags; //OBJ_FLAG_*
+    uint32_t refcount; //owners of this object, object_free only releases it when the last one lets go
     object_data_t data;
 } object_t;
 
+#define OBJ_FLAG_INTERNED 0x01 //the intern table's copy of this string, immortal, see string_intern
+#define OBJ_FLAG_ARENA 0x02 //lives in an object_arena_t, object_free leaves it alone
+#define OBJ_FLAG_GC 0x04 //owned by the tracing collector, object_free leaves it alone
+#define OBJ_FLAG_MARKED 0x08 //reached during the current collection
+#define OBJ_FLAG_VIEW 0x10 //allocated with a base object slot after its payload, see object_slice
+#define OBJ_FLAG_MALLOC 0x20 //header came from malloc while the slab allocator was off, see allocator_set_slab_enabled
+
+// Objects are allocated at the size of the union member their kind uses, not at
+// sizeof(object_t): a boxed INTEGER or FLOAT is the 8 byte header plus 4 bytes
+// (one 16 byte slab slot), a STRING or COLLECTION header is 40 bytes and a VECTOR
+// 24, with inline chars and coords in the tail right after it. Never copy an
+// object_t or a whole object_data_t by value; copy the member instead.
+#define OBJECT_SIZE_OF(member) (offsetof(object_t, data) + sizeof(((object_data_t *)0) -> member))
+
+// ======= IMMEDIATE VALUES =======
+// On 64-bit targets INTEGER and FLOAT values are never heap allocated: the value
+// is packed into the object_t pointer itself, so they live inline in the operand
+// stack and in collection.data exactly like any other object_t*. Heap objects are
+// at least 8 byte aligned, so a pointer with one of the low two bits set is an
+// immediate:
+//   value << 32 | 01  -> INTEGER
+//   bits  << 32 | 10  -> FLOAT (IEEE-754 single precision bits)
+// Immediates are never dereferenced; always go through object_kind, object_int
+// and object_float. object_free ignores them. Build with -DDYNC_NO_IMMEDIATES
+// (or on a 32-bit target) to box every scalar instead.
+#if UINTPTR_MAX > 0xFFFFFFFFu && !defined(DYNC_NO_IMMEDIATES)
+#define DYNC_IMMEDIATES 1
+#endif
+
+#define IMMEDIATE_TAG_MASK ((uintptr_t)0x3)
+#define IMMEDIATE_TAG_INT ((uintptr_t)0x1)
+#define IMMEDIATE_TAG_FLOAT ((uintptr_t)0x2)
+
+static inline bool object_is_immediate(const object_t *obj){
+    return ((uintptr_t)obj & IMMEDIATE_TAG_MASK) != 0;
+}
+
+static inline object_kind_t object_kind(const object_t *obj){
+    uintptr_t tag = (uintptr_t)obj & IMMEDIATE_TAG_MASK;
+    if (tag == IMMEDIATE_TAG_INT){
+        return INTEGER;
+    }
+    if (tag == IMMEDIATE_TAG_FLOAT){
+        return FLOAT;
+    }
+    return (object_kind_t)obj -> kind;
+}
+
+static inline int object_int(const object_t *obj){
+    if (object_is_immediate(obj)){
+        return (int32_t)(uint32_t)((uintptr_t)obj >> 32);
+    }
+    return obj -> data.v_int;
+}
+
+static inline float object_float(const object_t *obj){
+    if (object_is_immediate(obj)){
+        uint32_t bits = (uint32_t)((uintptr_t)obj >> 32);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    return obj -> data.v_float;
+}
+
+#ifdef DYNC_IMMEDIATES
+static inline object_t *immediate_int(int value){
+    return (object_t *)(((uintptr_t)(uint32_t)value << 32) | IMMEDIATE_TAG_INT);
+}
+
+static inline object_t *immediate_float(float value){
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (object_t *)(((uintptr_t)bits << 32) | IMMEDIATE_TAG_FLOAT);
+}
+#endif
+
+// ======= REFERENCE COUNTING =======
+// Heap objects are shared by counting their owners. object_retain adds an owner,
+// object_free drops one and only destroys the object when none are left. Strings,
+// vectors and matrices are never mutated once built, so cloning one is a retain.
+// Collections are mutable: a clone gets its own header sharing the item array,
+// which is copied on the first write (see collection_make_unique).
+// Counts are plain integers by default. Build with -DDYNC_ATOMIC_REFCOUNT when
+// objects are shared between threads. Rope nodes and the intern table stay
+// single-threaded either way.
+#ifdef DYNC_ATOMIC_REFCOUNT
+#define REFCOUNT_INCREMENT(count) __atomic_add_fetch(&(count), 1, __ATOMIC_RELAXED)
+#define REFCOUNT_DECREMENT(count) __atomic_sub_fetch(&(count), 1, __ATOMIC_ACQ_REL)
+#define REFCOUNT_LOAD(count) __atomic_load_n(&(count), __ATOMIC_ACQUIRE)
+#else
+#define REFCOUNT_INCREMENT(count) (++(count))
+#define REFCOUNT_DECREMENT(count) (--(count))
+#define REFCOUNT_LOAD(count) (count)
+#endif
+
+//Adds an owner to 'obj' and returns it. Each retain is balanced by an object_free.
+//Interned strings are never freed, so they are not counted at all.
+object_t *object_retain(object_t *obj){
+    if (obj != NULL && !object_is_immediate(obj) && !(obj -> flags & OBJ_FLAG_INTERNED)){
+        REFCOUNT_INCREMENT(obj -> refcount);
+    }
+    return obj;
+}
+
 // ======= VIRTUAL MACHINE ARCHITECTURE =======
 typedef enum {
     OP_PUSH_INT, //Push an integer unto vm stack
@@ -62,1242 +259,7460 @@ typedef enum {
     OP_DIV,      //Pop two objects, divide them, oush result to vm stack
     OP_PRINT,    //Pop an item and print it
     OP_HALT,     //Stop execution
-    OP_PUSH_FLOAT
+    OP_PUSH_FLOAT,
+    // Quickened forms, written over OP_ADD/SUB/MUL/DIV by run_vm once it has seen
+    // the operand kinds at that site. Keep the INT_INT, FLOAT_FLOAT, VEC_SCALAR
+    // order within each group, quicken_binary relies on it.
+    OP_ADD_INT_INT,
+    OP_ADD_FLOAT_FLOAT,
+    OP_ADD_VEC_SCALAR,
+    OP_SUB_INT_INT,
+    OP_SUB_FLOAT_FLOAT,
+    OP_SUB_VEC_SCALAR,
+    OP_MUL_INT_INT,
+    OP_MUL_FLOAT_FLOAT,
+    OP_MUL_VEC_SCALAR,
+    OP_DIV_INT_INT,
+    OP_DIV_FLOAT_FLOAT,
+    OP_DIV_VEC_SCALAR,
+    OP_DOT,      //Pop two vectors, push their dot product
+    OP_NORM,     //Pop a vector, push its L2 norm
+    OP_SUM,      //Pop a vector, push the sum of its coords
+    OP_MIN,      //Pop a vector, push its smallest coord
+    OP_MAX,      //Pop a vector, push its largest coord
+    OP_AXPY,     //Pop y, x and alpha, push alpha * x + y
+    OP_BUILD_MATRIX, //Build a matrix from the given number of row vectors on the vm stack
+    OP_MATMUL,   //Pop two objects, push their matrix-matrix or matrix-vector product
+    OP_BUILD_DICT, //Build a dict from the given number of key, value pairs on the vm stack
+    OP_GET,      //Pop a key and a dict (or an index and a collection), push the value stored there
+    OP_SET,      //Pop a value, a key and a dict (or collection), store the value, push the container back
+    OP_BUILD_SET, //Build a set from the given number of items on the vm stack
+    OP_CONTAINS, //Pop an item and a set, dict or collection, push 1 if the item is in it, else 0
+    OP_UNION,    //Pop two sets (or collections), push the set of items in either
+    OP_INTERSECT, //Pop two sets (or collections), push the set of items in both
+    OP_DIFFERENCE, //Pop two sets (or collections), push the set of items in the first but not the second
+    OP_SORT,     //Pop a collection, push it sorted in ascending object_compare order
+    OP_SLICE,    //Pop length, start and a string, vector or collection, push a view of that part of it
+    OP_BUILD_DEQUE, //Build a deque from the given number of items on the vm stack, the first one at the front
+    OP_PUSH_BACK, //Pop an item and a deque, add the item at the back, push the deque back (or a persistent list, push the new version)
+    OP_PUSH_FRONT, //Pop an item and a deque, add the item at the front, push the deque back
+    OP_POP_BACK, //Pop a deque, take its back item, push the deque and then the item
+    OP_POP_FRONT, //Pop a deque, take its front item, push the deque and then the item
+    OP_BUILD_PLIST, //Build a persistent list from the given number of items on the vm stack
+    OP_COUNT     //Number of opcodes, keep last
 } OpCode;
 
 typedef struct {
     size_t *bytecode;
     size_t ip;
-    object_t *operand_stack;
+    object_t **stack; //contiguous operand stack, stack[sp - 1] is the top
+    size_t sp; //number of live slots
+    size_t stack_capacity;
+    bool lazy_vectors; //defer chained element-wise vector arithmetic, see VECTOR_EXPR
+    struct object_arena *arena; //non-NULL in arena mode, see vm_set_arena
 } vm_t;
 
 
+// ======= OBJECT ALLOCATOR =======
+// Object headers are carved out of 64KB slabs in 16 byte size classes and
+// recycled through thread-local free lists, so the VM's push/pop churn never
+// reaches malloc. Requests above the largest class fall back to malloc.
+// Slabs are kept for the lifetime of the process (they are reused, never
+// returned), and a block freed on another thread simply joins that thread's list.
+// Whether the slabs are used at all is a per-thread switch; objects made while
+// it is off are flagged OBJ_FLAG_MALLOC, so each is freed the way it was allocated.
+#define SLAB_GRANULE 16
+#define SLAB_CLASS_COUNT 8 //16, 32, ... 128 bytes
+#define SLAB_BLOCK_SIZE (64 * 1024)
 
-//Integer object constructor
-object_t *new_object_integer(int value){
-    //Allocate enough memory for an object
-    object_t *new_obj = malloc(sizeof(object_t));
-    //check if memory allocation fails
-    if (new_obj == NULL){
-        return NULL;
-    }
-
-    //assign kind and actual integer value
-    new_obj -> kind = INTEGER;
-    new_obj -> data.v_int = value;
+typedef struct slab_node {
+    struct slab_node *next;
+} slab_node_t;
 
-    return new_obj;
+typedef struct {
+    size_t allocations; //blocks handed out (slab or malloc)
+    size_t frees; //blocks given back
+    size_t slab_refills; //64KB slabs carved for a size class
+    size_t fallback_allocations; //requests served by malloc
+    size_t payload_allocations; //out-of-line buffers (vector coords, matrix values)
+    size_t bytes_allocated; //block bytes handed out, a slab block counts as its whole chunk
+    size_t bytes_freed; //block bytes given back
+} allocator_stats_t;
+
+static DYNC_THREAD_LOCAL bool slab_enabled = true;
+static DYNC_THREAD_LOCAL slab_node_t *slab_free_lists[SLAB_CLASS_COUNT];
+static DYNC_THREAD_LOCAL slab_node_t *slab_blocks; //every slab this thread carved, kept reachable
+static DYNC_THREAD_LOCAL allocator_stats_t slab_stats;
+
+static inline size_t slab_class(size_t size){
+    return (size + SLAB_GRANULE - 1) / SLAB_GRANULE - 1;
 }
 
-//Float object constructor
-object_t *new_object_float(float value){
-    //check above function, we're essentialy doing the same thing
-   object_t *new_obj = (object_t *)malloc(sizeof(object_t));
-   if (new_obj == NULL){
-        return NULL;
-   }
-   new_obj -> kind = FLOAT;
-   new_obj -> data.v_float = value;
-
-   return new_obj;
+static bool slab_refill(size_t class_index){
+    size_t chunk = (class_index + 1) * SLAB_GRANULE;
+    char *block = malloc(SLAB_BLOCK_SIZE);
+    if (block == NULL){
+        return false;
+    }
+    //the first chunk links the slab into the block list
+    ((slab_node_t *)block) -> next = slab_blocks;
+    slab_blocks = (slab_node_t *)block;
+
+    for (size_t offset = SLAB_BLOCK_SIZE - chunk; offset >= chunk; offset -= chunk){
+        slab_node_t *node = (slab_node_t *)(block + offset);
+        node -> next = slab_free_lists[class_index];
+        slab_free_lists[class_index] = node;
+    }
+    slab_stats.slab_refills++;
+    return true;
 }
 
-
-object_t *new_object_string(char *value){
-    //Allocate enough memory for object
-   object_t *new_obj = malloc(sizeof(object_t));
-   //check if memory allocation fails
-   if (new_obj == NULL){
-        return NULL;
-   }
-   //assign data kind
-   new_obj -> kind = STRING;
-   //allocate enough memory for string and the null terminator
-   new_obj -> data.v_string = malloc(strlen(value) + 1);
-   //check if memory allocation fails
-   if(new_obj -> data.v_string == NULL){
-        free(new_obj);
+// ======= REGION ALLOCATION =======
+// An object_arena_t hands out memory by bumping a pointer through 1MB blocks and
+// only gives it back all at once, in object_arena_reset. While an arena is active
+// on a thread, every object created there (header and payload alike) comes out of
+// it and is flagged OBJ_FLAG_ARENA, which makes object_free a no-op for it. Objects
+// that have to outlive the region are copied out with object_promote. Arena objects
+// may hold heap objects but not the other way round, so strings made in an arena
+// are not interned and concatenation does not build ropes there.
+#define ARENA_BLOCK_SIZE ((size_t)1 << 20)
+
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t used;
+    size_t capacity;
+    char bytes[];
+} arena_block_t;
+
+typedef struct object_arena {
+    arena_block_t *blocks; //newest first, allocation only ever bumps the first one
+    arena_block_t *spare; //emptied blocks waiting to be reused
+    size_t bytes; //handed out since the last reset
+    size_t peak_bytes; //most bytes ever handed out between two resets
+} object_arena_t;
+
+static DYNC_THREAD_LOCAL object_arena_t *active_arena = NULL;
+
+object_arena_t *new_object_arena(void){
+    object_arena_t *arena = malloc(sizeof(object_arena_t));
+    if (arena == NULL){
         return NULL;
-   }
-   //copy passed string into object string field
-   strcpy(new_obj -> data.v_string, value);
+    }
+    arena -> blocks = NULL;
+    arena -> spare = NULL;
+    arena -> bytes = 0;
+    arena -> peak_bytes = 0;
+    return arena;
+}
 
-   return new_obj;
+//Makes 'arena' (or NULL, for the heap) the allocation target of this thread and returns the previous one
+object_arena_t *object_arena_activate(object_arena_t *arena){
+    object_arena_t *previous = active_arena;
+    active_arena = arena;
+    return previous;
 }
 
-object_t *new_object_vector(size_t dimens, float *coords){
-    object_t *new_object = malloc(sizeof(object_t));
-    if (new_object == NULL){
+static void *arena_alloc(object_arena_t *arena, size_t size, size_t align){
+    arena_block_t *block = arena -> blocks;
+    if (block != NULL){
+        uintptr_t start = ((uintptr_t)(block -> bytes + block -> used) + align - 1) & ~(uintptr_t)(align - 1);
+        if (start + size <= (uintptr_t)(block -> bytes + block -> capacity)){
+            block -> used = start + size - (uintptr_t)block -> bytes;
+            arena -> bytes += size;
+            return (void *)start;
+        }
+    }
+    size_t capacity = size + align > ARENA_BLOCK_SIZE ? size + align : ARENA_BLOCK_SIZE;
+    if (capacity == ARENA_BLOCK_SIZE && arena -> spare != NULL){
+        block = arena -> spare;
+        arena -> spare = block -> next;
+    }
+    else {
+        block = malloc(sizeof(arena_block_t) + capacity);
+    }
+    if (block == NULL){
         return NULL;
     }
+    block -> next = arena -> blocks;
+    block -> used = 0;
+    block -> capacity = capacity;
+    arena -> blocks = block;
+    return arena_alloc(arena, size, align);
+}
 
-    new_object -> kind = VECTOR;
-    new_object -> data.v_vector.dimensions = dimens;
-    new_object -> data.v_vector.coords = malloc(dimens * sizeof(float));
+//Releases every object allocated in the arena at once. Standard blocks are kept
+//on a spare list for the next run, oversized ones go back to malloc.
+void object_arena_reset(object_arena_t *arena){
+    if (arena == NULL){
+        return;
+    }
+    arena_block_t *block = arena -> blocks;
+    while (block != NULL){
+        arena_block_t *next = block -> next;
+        if (block -> capacity == ARENA_BLOCK_SIZE){
+            block -> used = 0;
+            block -> next = arena -> spare;
+            arena -> spare = block;
+        }
+        else {
+            free(block);
+        }
+        block = next;
+    }
+    arena -> blocks = NULL;
+    if (arena -> bytes > arena -> peak_bytes){
+        arena -> peak_bytes = arena -> bytes;
+    }
+    arena -> bytes = 0;
+}
 
-    if (new_object -> data.v_vector.coords == NULL){
-        free(new_object);
-        return NULL;
+void free_object_arena(object_arena_t *arena){
+    if (arena == NULL){
+        return;
+    }
+    if (active_arena == arena){
+        active_arena = NULL;
     }
+    object_arena_reset(arena);
+    while (arena -> spare != NULL){
+        arena_block_t *next = arena -> spare -> next;
+        free(arena -> spare);
+        arena -> spare = next;
+    }
+    free(arena);
+}
 
-    memcpy(new_object -> data.v_vector.coords, coords, sizeof(float) * dimens);
+// ======= TRACING COLLECTOR =======
+// gc_set_enabled(true) switches this thread to collected allocation. Objects created
+// from then on carry OBJ_FLAG_GC and a hidden gc_link_t in front of the header, and
+// object_free ignores them. gc_collect reclaims whatever cannot be reached from the
+// roots: the operand stacks of live VMs (run_vm registers its VM, free_virtual_machine
+// drops it) and the host slots passed to gc_add_root. run_vm collects at instruction
+// boundaries once enough objects have been allocated, host code outside the VM calls
+// gc_collect itself. Collected objects may hold heap objects, not the other way round:
+// the container inserts (collection_append, dict_set, deque_push_back, ...) refuse
+// to put a collected object into a heap or arena container (container_can_hold).
+// This is a plain non-moving mark-sweep: host code holds raw object_t pointers, so
+// objects cannot be moved into an older generation, and collection_set and friends
+// have no write barrier that a young-generation-only collection would need.
+#define GC_INITIAL_THRESHOLD ((size_t)1 << 16) //objects allocated before the first automatic collection
+#define GC_PAUSE_BUCKETS 16
+
+typedef struct gc_link {
+    struct gc_link *prev;
+    struct gc_link *next;
+} gc_link_t; //two pointers, so the object behind it stays 16 byte aligned
 
-    return new_object;
+typedef struct {
+    size_t collections;
+    size_t objects_freed;
+    size_t live_objects; //survivors of the last collection
+    uint64_t total_pause_ns;
+    uint64_t max_pause_ns;
+    size_t pause_histogram[GC_PAUSE_BUCKETS]; //bucket i counts pauses under 2^i microseconds, the last one also everything longer
+} gc_stats_t;
+
+static DYNC_THREAD_LOCAL bool gc_enabled = false;
+static DYNC_THREAD_LOCAL bool gc_pending = false; //checked by run_vm between instructions
+static DYNC_THREAD_LOCAL gc_link_t *gc_objects = NULL; //every collected object of this thread
+static DYNC_THREAD_LOCAL size_t gc_allocated = 0; //since the last collection
+static DYNC_THREAD_LOCAL size_t gc_threshold = GC_INITIAL_THRESHOLD;
+static DYNC_THREAD_LOCAL gc_stats_t gc_statistics;
+
+//Collected allocation for objects created on this thread from now on. Objects
+//already collected stay collected when this is switched off again.
+void gc_set_enabled(bool enabled){
+    gc_enabled = enabled;
 }
 
-object_t *new_object_collection(size_t capacity, bool is_stack) {
-    //check if capacity is 0
-    if (capacity == 0){
-        fprintf(stderr, "Cannot initialize collection kind with 0 capacity\n");
-        return NULL;
+//The OBJ_FLAG_* an object allocated right now gets. Arena mode wins over the collector.
+static inline uint8_t object_alloc_flags(void){
+    if (active_arena != NULL){
+        return OBJ_FLAG_ARENA;
     }
-    //allocate memory for object
-    object_t *new_obj = malloc(sizeof(object_t));
+    return gc_enabled ? OBJ_FLAG_GC : 0;
+}
 
-    //check if memory allocation fails
-    if(new_obj == NULL){
-        return NULL;
+static void *slab_alloc(size_t size){
+    slab_stats.allocations++;
+    if (!slab_enabled || size == 0 || size > SLAB_CLASS_COUNT * SLAB_GRANULE){
+        slab_stats.fallback_allocations++;
+        slab_stats.bytes_allocated += size;
+        return malloc(size);
     }
-
-    //set metadata for the new object collection
-    new_obj -> kind = COLLECTION;
-    new_obj -> data.v_collection.length = 0;
-    new_obj -> data.v_collection.stack = is_stack;
-    new_obj -> data.v_collection.capacity = capacity;
-
-    //allocate memory 
-    new_obj -> data.v_collection.data = calloc(capacity, sizeof(object_t *));
-
-    if (new_obj -> data.v_collection.data == NULL){
-        free(new_obj);
+    size_t class_index = slab_class(size);
+    if (slab_free_lists[class_index] == NULL && !slab_refill(class_index)){
+        slab_stats.allocations--;
         return NULL;
     }
-    return new_obj;
+    slab_node_t *node = slab_free_lists[class_index];
+    slab_free_lists[class_index] = node -> next;
+    slab_stats.bytes_allocated += (class_index + 1) * SLAB_GRANULE;
+    return node;
+}
 
+//'flags' are the header flags of the object in the block, they tell a malloc'd block from a slab chunk
+static void slab_dealloc(void *ptr, size_t size, uint8_t flags){
+    slab_stats.frees++;
+    if ((flags & OBJ_FLAG_MALLOC) || size == 0 || size > SLAB_CLASS_COUNT * SLAB_GRANULE){
+        slab_stats.bytes_freed += size;
+        free(ptr);
+        return;
+    }
+    size_t class_index = slab_class(size);
+    slab_stats.bytes_freed += (class_index + 1) * SLAB_GRANULE;
+    slab_node_t *node = ptr;
+    node -> next = slab_free_lists[class_index];
+    slab_free_lists[class_index] = node;
 }
 
-int object_length(object_t *obj){
-    if (obj == NULL){
-        fprintf(stderr, "Cannot perform operation on null parameters\n");
-        return -1;
+//Allocates 'size' bytes for an object. Must be released with object_dealloc and the
+//same size, after the header's flags have been set to object_header_flags().
+void *object_alloc(size_t size){
+    uint8_t mode = object_alloc_flags();
+    if (mode == OBJ_FLAG_ARENA){
+        return arena_alloc(active_arena, size, SLAB_GRANULE);
     }
-    switch (obj -> kind){
-        case INTEGER:
-            fprintf(stderr, "Cannot perform operation on Object of kind INTEGER\n");
-            return -1;
-        case FLOAT:
-            fprintf(stderr, "Cannot perform operation on Object of kind FLOAT\n");
-            return -1;
-        case STRING:
-            return strlen(obj -> data.v_string);
-        case COLLECTION:
-            return  obj -> data.v_collection.length;
-        default:
-            fprintf(stderr, "Error: Unknown object kind detected\n");
-            return -1;
+    if (mode == OBJ_FLAG_GC){
+        gc_link_t *link = slab_alloc(sizeof(gc_link_t) + size);
+        if (link == NULL){
+            return NULL;
+        }
+        link -> prev = NULL;
+        link -> next = gc_objects;
+        if (gc_objects != NULL){
+            gc_objects -> prev = link;
+        }
+        gc_objects = link;
+        if (++gc_allocated >= gc_threshold){
+            gc_pending = true;
+        }
+        return link + 1;
     }
-
+    return slab_alloc(size);
 }
 
-
-
-int collection_append(object_t *collection, object_t *item){
-    if(collection == NULL || item == NULL){
-        fprintf(stderr, "Cannot perform operation on null object\n");
-        return -1;
+void object_dealloc(void *ptr, size_t size){
+    if (ptr == NULL){
+        return;
     }
-    if (collection -> kind != COLLECTION){
-        fprintf(stderr, "Error: Can't perform append operation on non_collection kind\n");
-        return -1;
+    uint8_t flags = ((object_t *)ptr) -> flags;
+    if (flags & OBJ_FLAG_ARENA){
+        return;
     }
-    if (collection -> data.v_collection.capacity == collection -> data.v_collection.length){
-        size_t new_cap = collection -> data.v_collection.capacity * 2;
-        object_t **temp = realloc(collection -> data.v_collection.data, sizeof(object_t *) * new_cap);
-
-        if (temp == NULL){
-            return -1;
+    if (flags & OBJ_FLAG_GC){
+        //only reached when a constructor gives up half way, the collector frees its garbage itself
+        gc_link_t *link = (gc_link_t *)ptr - 1;
+        if (link -> prev != NULL){
+            link -> prev -> next = link -> next;
         }
-
-        collection -> data.v_collection.data = temp;
-        collection -> data.v_collection.capacity = new_cap;
-
+        else {
+            gc_objects = link -> next;
+        }
+        if (link -> next != NULL){
+            link -> next -> prev = link -> prev;
+        }
+        slab_dealloc(link, sizeof(gc_link_t) + size, flags);
+        return;
     }
-    collection -> data.v_collection.data[collection -> data.v_collection.length] = item;
+    slab_dealloc(ptr, size, flags);
+}
 
-    collection -> data.v_collection.length++;
-    
+// Out-of-line float storage for vectors and matrices. Buffers start on a 64 byte
+// boundary, so SIMD loads never straddle a cache line at the start of a buffer.
+// The alignment is done by hand on top of malloc (glibc's aligned_alloc is several
+// times slower for small sizes) and the raw pointer is stashed just below the buffer.
+#define FLOAT_BUFFER_ALIGN 64
 
-    return 0;
+static float *float_buffer_alloc(size_t count){
+    if (active_arena != NULL){
+        return arena_alloc(active_arena, count * sizeof(float), FLOAT_BUFFER_ALIGN);
+    }
+    char *raw = malloc(count * sizeof(float) + FLOAT_BUFFER_ALIGN);
+    if (raw == NULL){
+        return NULL;
+    }
+    slab_stats.payload_allocations++;
+    uintptr_t aligned = ((uintptr_t)raw + sizeof(void *) + FLOAT_BUFFER_ALIGN - 1) & ~(uintptr_t)(FLOAT_BUFFER_ALIGN - 1);
+    ((void **)aligned)[-1] = raw;
+    return (float *)aligned;
 }
 
-int collection_set(object_t *collection, size_t index, object_t *value){
-    if (collection == NULL || value == NULL){
-        fprintf(stderr, "Unable to perform operation with null values\n");
-        return -1;
+static void float_buffer_free(float *buffer){
+    if (buffer != NULL){
+        free(((void **)buffer)[-1]);
     }
+}
 
-    if (collection -> kind != COLLECTION){
-        fprintf(stderr, "Cannot perform operation on non_collection kind\n");
-        return -1;
-    }
+//The header flags of an object allocated right now: object_alloc_flags(), plus
+//OBJ_FLAG_MALLOC if object_alloc takes it from malloc instead of a slab
+static inline uint8_t object_header_flags(void){
+    uint8_t flags = object_alloc_flags();
+    return flags == OBJ_FLAG_ARENA || slab_enabled ? flags : flags | OBJ_FLAG_MALLOC;
+}
 
-    if (index >= collection -> data.v_collection.length){
-        fprintf(stderr, "Index specified is out of bounds\n");
-        return -1;
+//Allocates an object of 'size' bytes and fills in its header: one owner, and
+//OBJ_FLAG_ARENA or OBJ_FLAG_GC if it came out of the active arena or the collector
+static object_t *object_new(size_t size, object_kind_t kind){
+    object_t *obj = object_alloc(size);
+    if (obj == NULL){
+        return NULL;
     }
+    obj -> kind = kind;
+    obj -> flags = object_header_flags();
+    obj -> refcount = 1;
+    return obj;
+}
 
-    object_free(collection -> data.v_collection.data[index]);
+//Switches the calling thread between slab and plain malloc allocation. Objects
+//that are alive keep the allocator they came from, so this can be flipped at any time.
+void allocator_set_slab_enabled(bool enabled){
+    slab_enabled = enabled;
+}
 
-    collection -> data.v_collection.data[index] = value;
-    return 0;
+allocator_stats_t allocator_stats(void){
+    return slab_stats;
 }
 
+void allocator_reset_stats(void){
+    memset(&slab_stats, 0, sizeof(slab_stats));
+}
 
-object_t *collection_access(object_t *collection, size_t index){
-    if (collection == NULL){
-        fprintf(stderr, "Unable to perform operation with null values\n");
-        return NULL;
-    }
+void print_allocator_stats(void){
+    printf("Allocations: %zu\n", slab_stats.allocations);
+    printf("Frees: %zu\n", slab_stats.frees);
+    printf("Live blocks: %zu\n", slab_stats.allocations - slab_stats.frees);
+    printf("Live block bytes: %zu\n", slab_stats.bytes_allocated - slab_stats.bytes_freed);
+    printf("Slab refills: %zu\n", slab_stats.slab_refills);
+    printf("Malloc fallbacks: %zu\n", slab_stats.fallback_allocations);
+    printf("Payload buffers: %zu\n", slab_stats.payload_allocations);
+}
 
-    if (collection -> kind != COLLECTION){
-        fprintf(stderr, "Cannot perform operation on non_collection kind\n");
-        return NULL;
-    }
 
-    if (collection -> data.v_collection.stack == true){
-        fprintf(stderr, "Cannot perform operation on stack kind\n");
-        return NULL;
-    }
 
-    if (index >= collection -> data.v_collection.length){
-        fprintf(stderr, "Index specified is out of bounds\n");
+//Integer object constructor
+object_t *new_object_integer(int value){
+#ifdef DYNC_IMMEDIATES
+    //no allocation, the value travels inside the pointer
+    return immediate_int(value);
+#else
+    //Allocate enough memory for an object
+    object_t *new_obj = object_new(OBJECT_SIZE_OF(v_int), INTEGER);
+    //check if memory allocation fails
+    if (new_obj == NULL){
         return NULL;
     }
 
-    return collection -> data.v_collection.data[index];
+    //assign the actual integer value
+    new_obj -> data.v_int = value;
 
+    return new_obj;
+#endif
 }
 
+//Float object constructor
+object_t *new_object_float(float value){
+#ifdef DYNC_IMMEDIATES
+    return immediate_float(value);
+#else
+    //check above function, we're essentialy doing the same thing
+   object_t *new_obj = object_new(OBJECT_SIZE_OF(v_float), FLOAT);
+   if (new_obj == NULL){
+        return NULL;
+   }
+   new_obj -> data.v_float = value;
 
-int is_empty(object_t *collection_stack){
-    if (collection_stack -> kind != COLLECTION){
-        fprintf(stderr, "Cannot perform empty function on non_collection kind");
-        return -1;
-    }
-    if (collection_stack == NULL){
-        fprintf(stderr, "Cannot perform empty function on null object\n");
-        return -1;
-    }
+   return new_obj;
+#endif
+}
 
-    if (collection_stack -> data.v_collection.stack == false){
-        fprintf(stderr, "Cannot perform empty function on non_stack kind");
-        return -1;
-    }
 
-    if (collection_stack -> data.v_collection.length == 0){
-        return 1;
+//A slice view (see object_slice) keeps the object its payload points into in a
+//slot right after the payload, where inline chars or coords would otherwise go
+static inline object_t **view_base_slot(const object_t *obj){
+    size_t offset;
+    switch (object_kind(obj)){
+        case STRING:
+            offset = OBJECT_SIZE_OF(v_string);
+            break;
+        case VECTOR:
+            offset = OBJECT_SIZE_OF(v_vector);
+            break;
+        default:
+            offset = OBJECT_SIZE_OF(v_collection);
+            break;
     }
-    return 0;
+    return (object_t **)(void *)((char *)obj + offset);
 }
 
-
-object_t *collection_pop(object_t *collection){
-    if (collection == NULL){
-        return NULL;
-    }   
-    if (collection->kind != COLLECTION) {
-        fprintf(stderr, "Error: Cannot pop from non-collection\n");
+//The object a view borrows its payload from, NULL for anything owning its payload
+static inline object_t *view_base(const object_t *obj){
+    if (object_is_immediate(obj) || !(obj -> flags & OBJ_FLAG_VIEW)){
         return NULL;
     }
+    return *view_base_slot(obj);
+}
 
-    if (collection -> data.v_collection.length == 0){
-        fprintf(stderr, "Error: Cannot pop from empty collection\n");
-        return NULL;
+//Whether an object of allocation mode 'mode' (0, OBJ_FLAG_ARENA or OBJ_FLAG_GC) may
+//keep 'item' alive: arena and collected objects may hold heap ones but not the
+//other way round, since nothing traces a heap object and a region outlives none
+static inline bool mode_can_hold(uint8_t mode, const object_t *item){
+    if (object_is_immediate(item)){
+        return true;
     }
+    uint8_t item_mode = item -> flags & (OBJ_FLAG_ARENA | OBJ_FLAG_GC);
+    return item_mode == 0 || item_mode == mode;
+}
 
-    size_t top_index = collection -> data.v_collection.length - 1;
-    object_t *popped_item = collection -> data.v_collection.data[top_index];
+//Whether an object allocated right now may keep 'base' (or its payload) alive
+static inline bool view_can_hold(const object_t *base){
+    return mode_can_hold(object_alloc_flags(), base);
+}
 
-    collection -> data.v_collection.data[top_index] = NULL;
-    collection -> data.v_collection.length--;
+//Whether 'item' may be stored in 'container', with an error if not
+static bool container_can_hold(const object_t *container, const object_t *item){
+    if (mode_can_hold(container -> flags & (OBJ_FLAG_ARENA | OBJ_FLAG_GC), item)){
+        return true;
+    }
+    fprintf(stderr, "Cannot store an arena or collected object in a container outside of its arena or collector\n");
+    return false;
+}
 
-    return popped_item;
+// Strings of up to STRING_INLINE_MAX bytes are stored in the same allocation as
+// the object (small-string optimization); longer ones get one separate buffer.
+// Either way the length is kept alongside, so no path needs strlen after creation.
+#define STRING_INLINE_MAX 47
+
+static inline bool string_is_inline(const object_t *obj){
+    return obj -> data.v_string.chars == (const char *)obj + OBJECT_SIZE_OF(v_string);
 }
 
-object_t *stack_peek(object_t *collection){
-    if (collection == NULL){
-        return NULL;
+static inline size_t string_object_size(const object_t *obj){
+    if (obj -> flags & OBJ_FLAG_VIEW){
+        return OBJECT_SIZE_OF(v_string) + sizeof(object_t *);
     }
-
-    if (collection -> kind != COLLECTION) {
-        fprintf(stderr, "Error: Cannot peek from non-collection\n");
-        return NULL;
+    if (string_is_inline(obj)){
+        return OBJECT_SIZE_OF(v_string) + obj -> data.v_string.capacity + 1;
     }
+    return OBJECT_SIZE_OF(v_string);
+}
 
-    if ( collection -> data.v_collection.stack == false){
-        fprintf(stderr, "Cannot perform peek operation on non_stack kind");
+//String of 'length' uninitialized bytes (null terminator already in place)
+static object_t *new_object_string_uninit(size_t length){
+    bool inline_chars = length <= STRING_INLINE_MAX;
+    size_t size = OBJECT_SIZE_OF(v_string) + (inline_chars ? length + 1 : 0);
+    //Allocate enough memory for object
+    object_t *new_obj = object_new(size, STRING);
+    //check if memory allocation fails
+    if (new_obj == NULL){
         return NULL;
     }
+    //assign data kind
+    new_obj -> data.v_string.length = length;
+    new_obj -> data.v_string.capacity = length;
+    new_obj -> data.v_string.rope = NULL;
+    if (inline_chars){
+        new_obj -> data.v_string.chars = (char *)new_obj + OBJECT_SIZE_OF(v_string);
+    }
+    else {
+        //allocate enough memory for string and the null terminator
+        new_obj -> data.v_string.chars = active_arena != NULL ? arena_alloc(active_arena, length + 1, 1) : malloc(length + 1);
+        //check if memory allocation fails
+        if (new_obj -> data.v_string.chars == NULL){
+            object_dealloc(new_obj, size);
+            return NULL;
+        }
+    }
+    new_obj -> data.v_string.chars[length] = '\0';
 
-    if (collection -> data.v_collection.length == 0){
-        fprintf(stderr, "Error: Cannot peek from empty collection\n");
+    return new_obj;
+}
+
+//String constructor for 'length' bytes of 'value', which need not be null terminated
+object_t *new_object_string_n(const char *value, size_t length){
+    object_t *new_obj = new_object_string_uninit(length);
+    if (new_obj == NULL){
         return NULL;
     }
+    //copy passed string into object string field
+    memcpy(new_obj -> data.v_string.chars, value, length);
 
-    return collection -> data.v_collection.data[collection -> data.v_collection.length - 1];
+    return new_obj;
+}
 
+object_t *new_object_string(char *value){
+    return new_object_string_n(value, strlen(value));
+}
 
+// ======= ROPES =======
+// Concatenating long strings builds a rope (a tree of concatenations) in O(1)
+// instead of copying both operands, so building a string piece by piece is linear
+// rather than quadratic. The bytes live in leaf chunks. A leaf covers the first
+// 'length' bytes of its chunk, and when a leaf ends exactly where its chunk's
+// used bytes end, appending a short piece just writes into the chunk's spare
+// capacity and makes a longer leaf: older strings sharing the chunk never look
+// past their own length. Chunk capacity doubles from one chunk to the next, so a
+// string built from 1-byte pieces ends up with O(log n) chunks.
+// Ropes are kept AVL-balanced (the depths of a node's children differ by at most
+// one), so their depth stays logarithmic in the number of leaves however they
+// were built. Nodes and chunks are reference counted and shared between strings. A rope is
+// flattened back into contiguous chars (once, then cached) by whatever needs
+// them: print_object, object_equals, object_multiply. Ropes are not thread-safe.
+#define ROPE_CHUNK_MIN 256
+#define ROPE_CHUNK_MAX ((size_t)1 << 24)
+#define ROPE_APPEND_MAX 4096 //right operands up to this size are appended into the last chunk
+#define ROPE_SPINE_STACK 64 //rope_append walks right spines up to this deep without malloc
 
+typedef struct {
+    size_t refcount;
+    size_t used; //bytes written, leaves never extend past this
+    size_t capacity;
+    char bytes[];
+} rope_chunk_t;
+
+struct rope_node {
+    size_t refcount;
+    size_t length;
+    size_t depth; //0 for leaves
+    rope_node_t *left; //internal nodes only
+    rope_node_t *right;
+    rope_chunk_t *chunk; //leaves only: this leaf is chunk -> bytes[0, length)
+};
+
+//Concatenations producing at least this many bytes become ropes
+static size_t rope_threshold = 512;
+
+//Strings shorter than 'bytes' are always concatenated flat. SIZE_MAX disables ropes.
+void string_set_rope_threshold(size_t bytes){
+    rope_threshold = bytes;
 }
 
-
-void object_free(object_t *obj){
-    if (obj == NULL){
-        return;
-    }
-    
-    else if (obj -> kind == STRING){
-        free(obj -> data.v_string);
-    }
-    else if(obj -> kind == COLLECTION){
-        for (size_t i = 0; i < obj -> data.v_collection.length; i++){
-            object_free(obj -> data.v_collection.data[i]);
+static void rope_release(rope_node_t *node){
+    while (node != NULL && --node -> refcount == 0){
+        rope_node_t *right = node -> right;
+        if (node -> chunk != NULL && --node -> chunk -> refcount == 0){
+            free(node -> chunk);
         }
-        free(obj -> data.v_collection.data);
-    }
-    else if (obj -> kind == VECTOR){
-        free(obj -> data.v_vector.coords);
+        rope_release(node -> left);
+        free(node);
+        node = right; //walk the right spine without recursing
     }
+}
 
-    free(obj);
+static rope_node_t *rope_new_leaf(const char *bytes, size_t length, size_t capacity){
+    capacity = capacity < length ? length : capacity;
+    rope_chunk_t *chunk = malloc(sizeof(rope_chunk_t) + capacity);
+    rope_node_t *leaf = malloc(sizeof(rope_node_t));
+    if (chunk == NULL || leaf == NULL){
+        free(chunk);
+        free(leaf);
+        return NULL;
+    }
+    chunk -> refcount = 1;
+    chunk -> used = length;
+    chunk -> capacity = capacity;
+    memcpy(chunk -> bytes, bytes, length);
+
+    leaf -> refcount = 1;
+    leaf -> length = length;
+    leaf -> depth = 0;
+    leaf -> left = NULL;
+    leaf -> right = NULL;
+    leaf -> chunk = chunk;
+    return leaf;
+}
 
+//Copies the rope's bytes into 'out', which must hold node -> length bytes
+static void rope_copy(const rope_node_t *node, char *out){
+    while (node -> chunk == NULL){
+        rope_copy(node -> left, out);
+        out += node -> left -> length;
+        node = node -> right;
+    }
+    memcpy(out, node -> chunk -> bytes, node -> length);
 }
 
+//Internal node over left and right, taking over the caller's references to both.
+//Either may be NULL (a failed step further down), which releases the other.
+static rope_node_t *rope_node_new(rope_node_t *left, rope_node_t *right){
+    rope_node_t *node = left != NULL && right != NULL ? malloc(sizeof(rope_node_t)) : NULL;
+    if (node == NULL){
+        rope_release(left);
+        rope_release(right);
+        return NULL;
+    }
+    node -> refcount = 1;
+    node -> length = left -> length + right -> length;
+    node -> depth = (left -> depth > right -> depth ? left -> depth : right -> depth) + 1;
+    node -> left = left;
+    node -> right = right;
+    node -> chunk = NULL;
+    return node;
+}
 
+//Trades the caller's reference to an internal node for one to each of its children
+static void rope_unpack(rope_node_t *node, rope_node_t **left, rope_node_t **right){
+    *left = node -> left;
+    *right = node -> right;
+    (*left) -> refcount++;
+    (*right) -> refcount++;
+    rope_release(node);
+}
 
+//rope_node_new for children whose depths differ by up to two, rotating so the
+//result is balanced again. Nodes are shared, so a rotation copies the nodes it touches.
+static rope_node_t *rope_balance(rope_node_t *left, rope_node_t *right){
+    if (left == NULL || right == NULL){
+        return rope_node_new(left, right);
+    }
+    rope_node_t *outer;
+    rope_node_t *inner;
+    rope_node_t *inner_left;
+    rope_node_t *inner_right;
+    if (right -> depth > left -> depth + 1){
+        rope_unpack(right, &inner, &outer);
+        if (inner -> depth <= outer -> depth){
+            return rope_node_new(rope_node_new(left, inner), outer);
+        }
+        rope_unpack(inner, &inner_left, &inner_right);
+        return rope_node_new(rope_node_new(left, inner_left), rope_node_new(inner_right, outer));
+    }
+    if (left -> depth > right -> depth + 1){
+        rope_unpack(left, &outer, &inner);
+        if (inner -> depth <= outer -> depth){
+            return rope_node_new(outer, rope_node_new(inner, right));
+        }
+        rope_unpack(inner, &inner_left, &inner_right);
+        return rope_node_new(rope_node_new(outer, inner_left), rope_node_new(inner_right, right));
+    }
+    return rope_node_new(left, right);
+}
 
-object_t *object_add(object_t *a, object_t *b){
-        /**
-     * @brief Performs a polymorphic addition or collection merge.
-     *
-     * @warning **DESTRUCTIVE OPERATION FOR COLLECTIONS (MOVE SEMANTICS)**
-     * When adding two objects of kind COLLECTION, this function takes OWNERSHIP
-     * of the internal data of both 'a' and 'b'.
-     *
-     * @details
-     * - **Primitives (INT/FLOAT):** Returns a new object. 'a' and 'b' remain valid.
-     * - **Strings:** Returns a new string. 'a' and 'b' remain valid.
-     * - **Collections:** * 1. A new collection is created containing pointers to ALL items from 'a' and 'b'.
-     * 2. The items are **moved**, not copied. 
-     * 3. The input shells 'a' and 'b' are **FREED** and invalid after return.
-     *
-     * @param a The first operand. Consumed if COLLECTION.
-     * @param b The second operand. Consumed if COLLECTION.
-     * @return object_t* A new object containing the result, or NULL on failure.
-     */
-    if (a == NULL || b == NULL){
-        fprintf(stderr, "Cannot perform operation on Null data\n");
-        return NULL;
+//Joins two ropes, taking over the caller's references to both. When one is more
+//than a level deeper, the other is joined into its inner spine down to a subtree
+//of about its own depth, and only the nodes on that path are copied and rebalanced,
+//so a join costs O(difference in depth) allocations.
+static rope_node_t *rope_concat(rope_node_t *left, rope_node_t *right){
+    rope_node_t *outer;
+    rope_node_t *inner;
+    if (left -> depth > right -> depth + 1){
+        rope_unpack(left, &outer, &inner);
+        return rope_balance(outer, rope_concat(inner, right));
     }
-    
-    switch (a -> kind){
-        case INTEGER:
-            switch (b -> kind){
-                case INTEGER:
-                    return new_object_integer(a -> data.v_int + b -> data.v_int);
-                case FLOAT:
-                    return new_object_float((float)a -> data.v_int + b -> data.v_float);
-                default:
-                    fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
-                    return NULL;
-            }
-        case FLOAT:
-            switch (b -> kind){
-                case INTEGER:
-                    return new_object_float(a -> data.v_float + (float)b -> data.v_int);
-                case FLOAT:
-                    return new_object_float(a -> data.v_float + b -> data.v_float);
-                default:
-                    fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
-                    return NULL;
-            }
+    if (right -> depth > left -> depth + 1){
+        rope_unpack(right, &inner, &outer);
+        return rope_balance(rope_concat(left, inner), outer);
+    }
+    return rope_node_new(left, right);
+}
 
-        case STRING:{
-            if (b -> kind != STRING){
-                fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
-                return NULL;  
-            }
-            size_t length = strlen(a -> data.v_string) + strlen(b -> data.v_string) + 1;
+//rope + bytes, without consuming 'rope'. Writes into the last chunk's spare
+//capacity when no other string has claimed it, otherwise adds a bigger chunk.
+static rope_node_t *rope_append(rope_node_t *rope, const char *bytes, size_t length){
+    rope_node_t *leaf = rope;
+    while (leaf -> chunk == NULL){
+        leaf = leaf -> right;
+    }
 
-            char *new_string = calloc(length, sizeof(char));
-            if(new_string == NULL){
+    rope_chunk_t *chunk = leaf -> chunk;
+    if (leaf -> length == chunk -> used && chunk -> capacity - chunk -> used >= length){
+        //the right spine is at most rope -> depth nodes long
+        rope_node_t *stack_spine[ROPE_SPINE_STACK];
+        rope_node_t **spine = stack_spine;
+        if (rope -> depth > ROPE_SPINE_STACK){
+            spine = malloc(sizeof(rope_node_t *) * rope -> depth);
+            if (spine == NULL){
                 return NULL;
             }
-
-            strcat(new_string, a -> data.v_string);
-            strcat(new_string, b -> data.v_string);
-
-            object_t *newstring = new_object_string(new_string);
-            free(new_string);
-            return newstring;
         }
-        case COLLECTION:
-            if (b -> kind != COLLECTION){
-               fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
-               return NULL;          
+        size_t depth = 0;
+        for (rope_node_t *node = rope; node != leaf; node = node -> right){
+            spine[depth++] = node;
+        }
+        rope_node_t *grown = malloc(sizeof(rope_node_t));
+        if (grown == NULL){
+            if (spine != stack_spine){
+                free(spine);
             }
-
-            if (a->data.v_collection.stack || b->data.v_collection.stack){
-                fprintf(stderr, "object_add: can only concatenate non-stack collections (lists)\n");
-                return NULL;
+            return NULL;
+        }
+        memcpy(chunk -> bytes + chunk -> used, bytes, length);
+        chunk -> used += length;
+        chunk -> refcount++;
+        *grown = *leaf;
+        grown -> refcount = 1;
+        grown -> length += length;
+
+        //copy the right spine down to the grown leaf, everything else is shared
+        rope_node_t *child = grown;
+        while (depth > 0){
+            rope_node_t *old = spine[--depth];
+            rope_node_t *node = malloc(sizeof(rope_node_t));
+            if (node == NULL){
+                rope_release(child);
+                child = NULL;
+                break;
             }
+            *node = *old;
+            node -> refcount = 1;
+            node -> length += length;
+            node -> left -> refcount++;
+            node -> right = child;
+            child = node;
+        }
+        if (spine != stack_spine){
+            free(spine);
+        }
+        return child;
+    }
 
-            size_t total_length = a -> data.v_collection.length + b -> data.v_collection.length;
+    size_t capacity = chunk -> capacity * 2;
+    capacity = capacity < ROPE_CHUNK_MIN ? ROPE_CHUNK_MIN : capacity;
+    capacity = capacity > ROPE_CHUNK_MAX ? ROPE_CHUNK_MAX : capacity;
+    rope_node_t *tail = rope_new_leaf(bytes, length, capacity);
+    if (tail == NULL){
+        return NULL;
+    }
+    rope -> refcount++;
+    return rope_concat(rope, tail);
+}
 
-            size_t capacity = (total_length > 0) ? total_length : 1;
-            object_t *new_collection = new_object_collection(capacity, false);
+//A new reference to the string's bytes as a rope, copying them into a leaf if it is flat
+static rope_node_t *string_rope_ref(object_t *str){
+    if (str -> data.v_string.rope != NULL){
+        str -> data.v_string.rope -> refcount++;
+        return str -> data.v_string.rope;
+    }
+    size_t length = str -> data.v_string.length;
+    return rope_new_leaf(str -> data.v_string.chars, length, length * 2);
+}
 
-            for (size_t i = 0; i < a -> data.v_collection.length; i++){
-                collection_append(new_collection, a -> data.v_collection.data[i]);
-            }
-            for (size_t j = 0; j < b -> data.v_collection.length; j++){
-                collection_append(new_collection, b -> data.v_collection.data[j]);
-            }
-            // [DO NOT TOUCH] PREVENT RECURSIVE DESTRUCTION
-            // We set lengths to 0 so object_free() destroys the array wrapper
-            // but does NOT touch the items (which now belong to new_collection).
-            // Removing this line causes Double Free errors.
-            a -> data.v_collection.length = 0;
-            b -> data.v_collection.length = 0;
-            return new_collection;
-        case VECTOR:{
-            switch(b -> kind){
-                case INTEGER:{
-                    float scalar = (float)b -> data.v_int;
-                    float buffer[a -> data.v_vector.dimensions];
+//STRING object wrapping a rope, takes over the reference
+static object_t *new_object_string_rope(rope_node_t *rope){
+    if (rope == NULL){
+        return NULL;
+    }
+    object_t *new_obj = object_new(OBJECT_SIZE_OF(v_string), STRING);
+    if (new_obj == NULL){
+        rope_release(rope);
+        return NULL;
+    }
+    new_obj -> data.v_string.length = rope -> length;
+    new_obj -> data.v_string.capacity = 0;
+    new_obj -> data.v_string.chars = NULL;
+    new_obj -> data.v_string.rope = rope;
+    return new_obj;
+}
 
-                    for (size_t i = 0; i < a -> data.v_vector.dimensions; i++){
-                        buffer[i] = a -> data.v_vector.coords[i] + scalar;
-                    }
+//a + b for two strings whose combined length is past rope_threshold
+static object_t *string_concat_rope(object_t *a, object_t *b){
+    rope_node_t *left = string_rope_ref(a);
+    if (left == NULL){
+        return NULL;
+    }
+    if (b -> data.v_string.rope == NULL && b -> data.v_string.length <= ROPE_APPEND_MAX){
+        rope_node_t *joined = rope_append(left, b -> data.v_string.chars, b -> data.v_string.length);
+        rope_release(left);
+        return new_object_string_rope(joined);
+    }
+    rope_node_t *right = string_rope_ref(b);
+    if (right == NULL){
+        rope_release(left);
+        return NULL;
+    }
+    return new_object_string_rope(rope_concat(left, right));
+}
 
-                    object_t *new_vector = new_object_vector(a -> data.v_vector.dimensions, buffer);
+//Makes the string's bytes contiguous (a no-op unless it is a rope) and returns them
+static const char *string_flatten(object_t *str){
+    rope_node_t *rope = str -> data.v_string.rope;
+    if (rope == NULL){
+        return str -> data.v_string.chars;
+    }
+    char *chars = malloc(rope -> length + 1);
+    if (chars == NULL){
+        return NULL;
+    }
+    rope_copy(rope, chars);
+    chars[rope -> length] = '\0';
+    rope_release(rope);
+
+    str -> data.v_string.rope = NULL;
+    str -> data.v_string.chars = chars;
+    str -> data.v_string.capacity = str -> data.v_string.length;
+    return chars;
+}
 
-                    return new_vector;
-                }
+// ======= STRING INTERNING =======
+// Interned strings are ordinary STRING objects that are unique by content: the
+// intern table maps bytes to the one object holding them, so two interned strings
+// are equal exactly when they are the same pointer. OP_PUSH_STRING interns its
+// literals, other strings opt in via string_intern.
+// Interned strings are immortal: object_retain and object_free leave them alone
+// and they stay in the table until the process exits. That keeps their refcount
+// out of reach of every thread, so a string interned on one thread may be held
+// and dropped on any other, and the table never hands out a string that is being
+// freed. The cost is that every distinct text interned stays allocated, so intern
+// literals and other small, repeating sets of names, not arbitrary input.
+// Interned strings are shared and therefore never mutated. Every thread has its
+// own table, so VMs on different threads never touch each other's literals.
 
-                case FLOAT:{
-                    float scalar = b -> data.v_float;
-                    float buffer[a -> data.v_vector.dimensions];
+typedef struct {
+    uint64_t hash;
+    object_t *str; //NULL for an empty slot
+} intern_slot_t;
+
+static DYNC_THREAD_LOCAL intern_slot_t *intern_slots = NULL;
+static DYNC_THREAD_LOCAL size_t intern_capacity = 0; //power of two
+static DYNC_THREAD_LOCAL size_t intern_count = 0;
+
+static uint64_t string_hash(const char *chars, size_t length){
+    //FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++){
+        hash ^= (unsigned char)chars[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
 
-                    for (size_t i = 0; i < a -> data.v_vector.dimensions; i++){
-                        buffer[i] = a -> data.v_vector.coords[i] + scalar;
-                    }
+static inline bool string_is_interned(const object_t *obj){
+    return !object_is_immediate(obj) && object_kind(obj) == STRING && (obj -> flags & OBJ_FLAG_INTERNED) != 0;
+}
 
-                    object_t *new_vector = new_object_vector(a -> data.v_vector.dimensions, buffer);
-                    return new_vector;
+static bool intern_grow(void){
+    size_t capacity = intern_capacity == 0 ? 256 : intern_capacity * 2;
+    intern_slot_t *slots = calloc(capacity, sizeof(intern_slot_t));
+    if (slots == NULL){
+        return false;
+    }
+    for (size_t i = 0; i < intern_capacity; i++){
+        if (intern_slots[i].str == NULL){
+            continue;
+        }
+        size_t j = intern_slots[i].hash & (capacity - 1);
+        while (slots[j].str != NULL){
+            j = (j + 1) & (capacity - 1);
+        }
+        slots[j] = intern_slots[i];
+    }
+    free(intern_slots);
+    intern_slots = slots;
+    intern_capacity = capacity;
+    return true;
+}
 
-                }
-                case VECTOR:{
-                    if (a -> data.v_vector.dimensions != b -> data.v_vector.dimensions){
-                        fprintf(stderr, "Cannot perform element wise addition on vectors in different dimenstions");
-                        object_free(a);
-                        object_free(b);
-                        return NULL;
-                    }
-                    float buffer[a -> data.v_vector.dimensions];
+//The interned string holding 'length' bytes of 'value', as a new reference
+object_t *new_object_string_interned(const char *value, size_t length){
+    if (object_alloc_flags() != 0){
+        //the table is never traced and outlives any region, such strings stay private copies
+        return new_object_string_n(value, length);
+    }
+    uint64_t hash = string_hash(value, length);
+    if (intern_capacity > 0){
+        size_t mask = intern_capacity - 1;
+        for (size_t i = hash & mask; intern_slots[i].str != NULL; i = (i + 1) & mask){
+            object_t *str = intern_slots[i].str;
+            if (intern_slots[i].hash == hash && str -> data.v_string.length == length &&
+                memcmp(str -> data.v_string.chars, value, length) == 0){
+                return object_retain(str);
+            }
+        }
+    }
+    //keep the table at most half full so probe chains stay short
+    if ((intern_count + 1) * 2 > intern_capacity && !intern_grow()){
+        return NULL;
+    }
+    object_t *str = new_object_string_n(value, length);
+    if (str == NULL){
+        return NULL;
+    }
+    str -> flags |= OBJ_FLAG_INTERNED;
 
-                    for (size_t i = 0; i < a -> data.v_vector.dimensions; i++){
-                        buffer[i] = a -> data.v_vector.coords[i] + b -> data.v_vector.coords[i];
-                    }
+    size_t mask = intern_capacity - 1;
+    size_t i = hash & mask;
+    while (intern_slots[i].str != NULL){
+        i = (i + 1) & mask;
+    }
+    intern_slots[i].hash = hash;
+    intern_slots[i].str = str;
+    intern_count++;
+    return str;
+}
 
-                    object_t *new_vector = new_object_vector(a -> data.v_vector.dimensions, buffer);
+//The interned string with the same bytes as 'str', as a new reference. 'str' is left alone.
+object_t *string_intern(object_t *str){
+    if (str == NULL || object_kind(str) != STRING){
+        fprintf(stderr, "Error: Cannot intern a non-string\n");
+        return NULL;
+    }
+    if (string_is_interned(str)){
+        return object_retain(str);
+    }
+    const char *chars = string_flatten(str);
+    if (chars == NULL){
+        return NULL;
+    }
+    return new_object_string_interned(chars, str -> data.v_string.length);
+}
 
-                    return new_vector;
+// Vectors of up to VECTOR_INLINE_MAX dimensions (the 2D/3D/4D geometry case and
+// then some) keep their coords in the same allocation, right after the object,
+// so they cost one slab allocation and no extra pointer chase. Larger vectors get
+// a separate 64 byte aligned buffer from float_buffer_alloc.
+#define VECTOR_INLINE_MAX 8
 
-                }
-                default:
-                    fprintf(stderr,"Incompatible kinds");
-                    object_free(a);
-                    object_free(b);
-                    return NULL;
+static size_t vector_inline_limit = VECTOR_INLINE_MAX;
 
-            }
-        }
-            
-        default: return NULL;
-    }
+//Caps inline storage at 'dimensions' (at most VECTOR_INLINE_MAX), 0 disables it.
+//Only affects vectors created afterwards.
+void vector_set_inline_limit(size_t dimensions){
+    vector_inline_limit = dimensions < VECTOR_INLINE_MAX ? dimensions : VECTOR_INLINE_MAX;
+}
 
+static inline bool vector_is_inline(const object_t *obj){
+    return obj -> data.v_vector.coords == (const float *)((const char *)obj + OBJECT_SIZE_OF(v_vector));
+}
 
+static inline size_t vector_object_size(const object_t *obj){
+    if (obj -> flags & OBJ_FLAG_VIEW){
+        return OBJECT_SIZE_OF(v_vector) + sizeof(object_t *);
+    }
+    if (vector_is_inline(obj)){
+        return OBJECT_SIZE_OF(v_vector) + sizeof(float) * obj -> data.v_vector.dimensions;
+    }
+    return OBJECT_SIZE_OF(v_vector);
 }
 
-bool object_equals(object_t *a, object_t *b){
-    if (a == NULL || b == NULL){
-        return false;
+//Vector with uninitialized coords, for kernels that write their result in place
+static object_t *new_object_vector_uninit(size_t dimens){
+    bool inline_coords = dimens <= vector_inline_limit;
+    size_t size = OBJECT_SIZE_OF(v_vector) + (inline_coords ? sizeof(float) * dimens : 0);
+    object_t *new_object = object_new(size, VECTOR);
+    if (new_object == NULL){
+        return NULL;
     }
-    
-    if (a -> kind != b -> kind){
-        return false;
+    new_object -> data.v_vector.dimensions = dimens;
+    if (inline_coords){
+        new_object -> data.v_vector.coords = (float *)((char *)new_object + OBJECT_SIZE_OF(v_vector));
+        return new_object;
     }
-    switch (a -> kind){
-        case INTEGER:
-            if(a -> data.v_int == b -> data.v_int){
-                return true;
-            }
-            else{
-                return false;
-            }
-        case FLOAT:
-            if(a -> data.v_float == b -> data.v_float){
-                return true;
-            }
-            else{
-                return false;
-            }
-        case STRING:
-            if(strcmp(a -> data.v_string,  b -> data.v_string) == 0){
-                return true;
-            }
-            else {
-                return false;
-            }
-        case COLLECTION:
-            if (b -> data.v_collection.length != a -> data.v_collection.length){
-                return false;
-            }
-            else{
-                for (size_t i = 0; i < b -> data.v_collection.length; i++){
-                    object_t *a_check = a -> data.v_collection.data[i];
-                    object_t *b_check = b -> data.v_collection.data[i];
+    new_object -> data.v_vector.coords = float_buffer_alloc(dimens);
 
-                    if (object_equals(a_check, b_check) == false){
-                        return false;
-                    }
-                    
-                }
-                return true;
-            }
-        default:
-            return false;
+    if (new_object -> data.v_vector.coords == NULL){
+        object_dealloc(new_object, size);
+        return NULL;
+    }
+
+    return new_object;
+}
 
+object_t *new_object_vector(size_t dimens, float *coords){
+    object_t *new_object = new_object_vector_uninit(dimens);
+    if (new_object == NULL){
+        return NULL;
     }
-    return false;
+
+    memcpy(new_object -> data.v_vector.coords, coords, sizeof(float) * dimens);
+
+    return new_object;
 }
 
-object_t *object_clone(object_t *obj){
-    if (obj == NULL){
-        fprintf(stderr, "Cannot perform operation on Null data\n");
-        return NULL;   
+//Matrix with uninitialized values, for kernels that write their result in place
+static object_t *new_object_matrix_uninit(size_t rows, size_t cols){
+    if (rows == 0 || cols == 0){
+        fprintf(stderr, "Cannot initialize matrix kind with 0 rows or columns\n");
+        return NULL;
     }
-    switch(obj -> kind){
-        case INTEGER:
-            return new_object_integer(obj -> data.v_int);
-        case FLOAT:
-            return new_object_float(obj -> data.v_float);
-        case STRING:
-            return new_object_string(obj -> data.v_string);
-        case COLLECTION:{
-            object_t *collection_clone = new_object_collection(obj -> data.v_collection.capacity, obj -> data.v_collection.stack);
+    object_t *new_object = object_new(OBJECT_SIZE_OF(v_matrix), MATRIX);
+    if (new_object == NULL){
+        return NULL;
+    }
+    new_object -> data.v_matrix.rows = rows;
+    new_object -> data.v_matrix.cols = cols;
+    new_object -> data.v_matrix.values = float_buffer_alloc(rows * cols);
 
-            for (size_t i = 0; i < obj -> data.v_collection.length; i++){
-                collection_append(collection_clone, object_clone(obj -> data.v_collection.data[i]));
-            }
-            return collection_clone;
-        }
-        default:
-            return NULL;
-            
+    if (new_object -> data.v_matrix.values == NULL){
+        object_dealloc(new_object, OBJECT_SIZE_OF(v_matrix));
+        return NULL;
     }
-    return NULL;
+
+    return new_object;
 }
 
-object_t *object_subtract(object_t *a, object_t *b){
-     if (a == NULL || b == NULL){
-        fprintf(stderr, "Cannot perform operation on Null data\n");
+//Matrix constructor, 'values' holds rows * cols floats in row-major order
+object_t *new_object_matrix(size_t rows, size_t cols, float *values){
+    object_t *new_object = new_object_matrix_uninit(rows, cols);
+    if (new_object == NULL){
         return NULL;
     }
-    switch(a -> kind){
+
+    memcpy(new_object -> data.v_matrix.values, values, sizeof(float) * rows * cols);
+
+    return new_object;
+}
+
+// Collection item arrays carry their own reference count in a hidden size_t just
+// below data[0], so object_clone can hand out a new collection sharing the array.
+// A shared array is never written: every mutator first calls collection_make_unique,
+// which gives the collection a private copy holding retained (not cloned) items.
+// The array owns its items, they are released along with the last reference to it.
+static inline size_t *collection_store_refcount(object_t **data){
+    return (size_t *)data - 1;
+}
+
+// Typed collections: when every item is an immediate INTEGER (or every item an
+// immediate FLOAT) the array holds the raw int32_t/float values instead of
+// pointers, half the memory and nothing to chase when scanning. OP_BUILD_COLLECTION
+// picks packed storage by itself, new_object_typed_collection asks for it up front.
+// Appending or setting an item of any other kind first converts the collection
+// back to boxed pointers (collection_fit). Reads go through collection_item, which
+// rebuilds the immediate, so collection_access and friends never see the difference.
+// Only builds with immediates pack; with -DDYNC_NO_IMMEDIATES every collection is boxed.
+static inline size_t collection_item_size(uint8_t items){
+    return items == ITEMS_BOXED ? sizeof(object_t *) : sizeof(int32_t);
+}
+
+static inline int32_t *collection_ints(const object_t *collection){
+    return (int32_t *)(void *)collection -> data.v_collection.data;
+}
+
+static inline float *collection_floats(const object_t *collection){
+    return (float *)(void *)collection -> data.v_collection.data;
+}
+
+//Packed storage that can hold 'item', ITEMS_BOXED if none can
+static inline uint8_t collection_items_for(const object_t *item){
+    if (!object_is_immediate(item)){
+        return ITEMS_BOXED;
+    }
+    return object_kind(item) == INTEGER ? ITEMS_INT : ITEMS_FLOAT;
+}
+
+//Item 'index' as an object_t*, borrowed like collection_access
+static inline object_t *collection_item(const object_t *collection, size_t index){
+#ifdef DYNC_IMMEDIATES
+    switch (collection -> data.v_collection.items){
+        case ITEMS_INT:
+            return immediate_int(collection_ints(collection)[index]);
+        case ITEMS_FLOAT:
+            return immediate_float(collection_floats(collection)[index]);
+        default:
+            break;
+    }
+#endif
+    return collection -> data.v_collection.data[index];
+}
+
+//Stores 'item' in slot 'index', the storage must already fit it (see collection_fit)
+static inline void collection_put(object_t *collection, size_t index, object_t *item){
+    switch (collection -> data.v_collection.items){
+        case ITEMS_INT:
+            collection_ints(collection)[index] = object_int(item);
+            break;
+        case ITEMS_FLOAT:
+            collection_floats(collection)[index] = object_float(item);
+            break;
+        default:
+            collection -> data.v_collection.data[index] = item;
+            break;
+    }
+}
+
+//Item 'index' of a DEQUE counted from the front, borrowed
+static inline object_t *deque_item(const object_t *deque, size_t index){
+    return deque -> data.v_deque.items[(deque -> data.v_deque.head + index) & (deque -> data.v_deque.capacity - 1)];
+}
+
+static object_t *plist_item(const object_t *list, size_t index);
+
+//Item array for 'collection', from its arena if it lives in one
+static object_t **collection_store_alloc(object_t *collection, size_t capacity, uint8_t items){
+    size_t bytes = sizeof(size_t) + collection_item_size(items) * capacity;
+    char *raw;
+    if (collection -> flags & OBJ_FLAG_ARENA){
+        if (active_arena == NULL){
+            fprintf(stderr, "Cannot grow an arena collection outside of its arena\n");
+            return NULL;
+        }
+        raw = arena_alloc(active_arena, bytes, sizeof(size_t));
+        if (raw != NULL){
+            memset(raw, 0, bytes);
+        }
+    }
+    else {
+        raw = calloc(1, bytes);
+    }
+    if (raw == NULL){
+        return NULL;
+    }
+    *(size_t *)raw = 1;
+    return (object_t **)(void *)(raw + sizeof(size_t));
+}
+
+//Resizes the collection's private item array
+static object_t **collection_store_resize(object_t *collection, size_t capacity){
+    object_t **data = collection -> data.v_collection.data;
+    size_t item_size = collection_item_size(collection -> data.v_collection.items);
+    if (collection -> flags & OBJ_FLAG_ARENA){
+        //regions cannot grow a block in place, move to a fresh one
+        object_t **moved = collection_store_alloc(collection, capacity, collection -> data.v_collection.items);
+        if (moved != NULL){
+            memcpy(moved, data, item_size * collection -> data.v_collection.length);
+        }
+        return moved;
+    }
+    char *raw = realloc(collection_store_refcount(data), sizeof(size_t) + item_size * capacity);
+    return raw == NULL ? NULL : (object_t **)(void *)(raw + sizeof(size_t));
+}
+
+//Drops a reference to an item array of 'length' items, freeing it with the last one
+static void collection_store_release(object_t **data, size_t length, uint8_t items){
+    if (REFCOUNT_DECREMENT(*collection_store_refcount(data)) > 0){
+        return;
+    }
+    if (items == ITEMS_BOXED){
+        for (size_t i = 0; i < length; i++){
+            object_free(data[i]);
+        }
+    }
+    free(collection_store_refcount(data));
+}
+
+//Lets go of the collection's item array before it is replaced by 'store'
+static void collection_store_replace(object_t *collection, object_t **store, uint8_t items){
+    object_t **data = collection -> data.v_collection.data;
+    if (collection -> flags & OBJ_FLAG_ARENA){
+        //the old array goes away with its region
+        REFCOUNT_DECREMENT(*collection_store_refcount(data));
+    }
+    else {
+        collection_store_release(data, collection -> data.v_collection.length, collection -> data.v_collection.items);
+    }
+    collection -> data.v_collection.data = store;
+    collection -> data.v_collection.items = items;
+}
+
+//Gives a collection view an item array of its own holding the window's items
+//(retained) and lets go of its base. The block keeps its empty base slot.
+static int collection_detach(object_t *collection){
+    size_t length = collection -> data.v_collection.length;
+    uint8_t items = collection -> data.v_collection.items;
+    size_t capacity = length > 0 ? length : 1;
+    object_t **copy = collection_store_alloc(collection, capacity, items);
+    if (copy == NULL){
+        return -1;
+    }
+    if (items == ITEMS_BOXED){
+        for (size_t i = 0; i < length; i++){
+            copy[i] = object_retain(collection -> data.v_collection.data[i]);
+        }
+    }
+    else {
+        memcpy(copy, collection -> data.v_collection.data, collection_item_size(items) * length);
+    }
+    object_t **slot = view_base_slot(collection);
+    object_free(*slot);
+    *slot = NULL;
+    collection -> data.v_collection.data = copy;
+    collection -> data.v_collection.capacity = capacity;
+    return 0;
+}
+
+//Copy-on-write: makes sure no other collection shares this one's item array
+static int collection_make_unique(object_t *collection){
+    if (view_base(collection) != NULL){
+        return collection_detach(collection);
+    }
+    object_t **data = collection -> data.v_collection.data;
+    if (REFCOUNT_LOAD(*collection_store_refcount(data)) == 1){
+        return 0;
+    }
+    size_t length = collection -> data.v_collection.length;
+    uint8_t items = collection -> data.v_collection.items;
+    object_t **copy = collection_store_alloc(collection, collection -> data.v_collection.capacity, items);
+    if (copy == NULL){
+        return -1;
+    }
+    if (items == ITEMS_BOXED){
+        for (size_t i = 0; i < length; i++){
+            copy[i] = object_retain(data[i]);
+        }
+    }
+    else {
+        memcpy(copy, data, collection_item_size(items) * length);
+    }
+    collection_store_replace(collection, copy, items);
+    return 0;
+}
+
+//Converts packed storage back to boxed pointers
+static int collection_unpack(object_t *collection){
+    if (collection -> data.v_collection.items == ITEMS_BOXED){
+        return 0;
+    }
+    object_t **boxed = collection_store_alloc(collection, collection -> data.v_collection.capacity, ITEMS_BOXED);
+    if (boxed == NULL){
+        return -1;
+    }
+    for (size_t i = 0; i < collection -> data.v_collection.length; i++){
+        boxed[i] = collection_item(collection, i);
+    }
+    collection_store_replace(collection, boxed, ITEMS_BOXED);
+    return 0;
+}
+
+//Converts packed storage back to boxed pointers if it cannot hold 'item'
+static int collection_fit(object_t *collection, object_t *item){
+    uint8_t items = collection -> data.v_collection.items;
+    if (items == ITEMS_BOXED || collection_items_for(item) == items){
+        return 0;
+    }
+    return collection_unpack(collection);
+}
+
+static object_t *collection_new(size_t capacity, bool is_stack, uint8_t items){
+    //check if capacity is 0
+    if (capacity == 0){
+        fprintf(stderr, "Cannot initialize collection kind with 0 capacity\n");
+        return NULL;
+    }
+    //allocate memory for object
+    object_t *new_obj = object_new(OBJECT_SIZE_OF(v_collection), COLLECTION);
+
+    //check if memory allocation fails
+    if(new_obj == NULL){
+        return NULL;
+    }
+
+    //set metadata for the new object collection
+    new_obj -> data.v_collection.length = 0;
+    new_obj -> data.v_collection.stack = is_stack;
+    new_obj -> data.v_collection.capacity = capacity;
+    new_obj -> data.v_collection.items = items;
+
+    //allocate memory 
+    new_obj -> data.v_collection.data = collection_store_alloc(new_obj, capacity, items);
+
+    if (new_obj -> data.v_collection.data == NULL){
+        object_dealloc(new_obj, OBJECT_SIZE_OF(v_collection));
+        return NULL;
+    }
+    return new_obj;
+
+}
+
+//New collection in the current allocation mode with an item array of its own
+//holding the same items (retained), O(n)
+static object_t *collection_copy(object_t *collection){
+    size_t length = collection -> data.v_collection.length;
+    uint8_t items = collection -> data.v_collection.items;
+    object_t *copy = collection_new(length > 0 ? length : 1, collection -> data.v_collection.stack, items);
+    if (copy == NULL){
+        return NULL;
+    }
+    if (items == ITEMS_BOXED){
+        for (size_t i = 0; i < length; i++){
+            copy -> data.v_collection.data[i] = object_retain(collection -> data.v_collection.data[i]);
+        }
+    }
+    else {
+        memcpy(copy -> data.v_collection.data, collection -> data.v_collection.data, collection_item_size(items) * length);
+    }
+    copy -> data.v_collection.length = length;
+    return copy;
+}
+
+//New collection header over the same item array as 'collection', O(1), or a
+//copy when the array's arena or collector rules out sharing it from here
+static object_t *collection_share(object_t *collection){
+    if (!view_can_hold(collection)){
+        //an arena or collected array cannot be shared with an object made here
+        return collection_copy(collection);
+    }
+    object_t *base = view_base(collection);
+    object_t *new_obj = object_new(OBJECT_SIZE_OF(v_collection) + (base != NULL ? sizeof(object_t *) : 0), COLLECTION);
+    if (new_obj == NULL){
+        return NULL;
+    }
+    new_obj -> data.v_collection = collection -> data.v_collection;
+    if (base != NULL){
+        //another view of the same window
+        new_obj -> flags |= OBJ_FLAG_VIEW;
+        *view_base_slot(new_obj) = object_retain(base);
+        return new_obj;
+    }
+    REFCOUNT_INCREMENT(*collection_store_refcount(collection -> data.v_collection.data));
+    return new_obj;
+}
+
+object_t *new_object_collection(size_t capacity, bool is_stack){
+    return collection_new(capacity, is_stack, ITEMS_BOXED);
+}
+
+//Collection that stores INTEGER or FLOAT items as packed values (see collection_item).
+//Any other item_kind, or a build without immediates, gives a plain collection.
+object_t *new_object_typed_collection(size_t capacity, bool is_stack, object_kind_t item_kind){
+    uint8_t items = ITEMS_BOXED;
+#ifdef DYNC_IMMEDIATES
+    if (item_kind == INTEGER){
+        items = ITEMS_INT;
+    }
+    else if (item_kind == FLOAT){
+        items = ITEMS_FLOAT;
+    }
+#else
+    (void)item_kind;
+#endif
+    return collection_new(capacity, is_stack, items);
+}
+
+int object_length(object_t *obj){
+    if (obj == NULL){
+        fprintf(stderr, "Cannot perform operation on null parameters\n");
+        return -1;
+    }
+    switch (object_kind(obj)){
+        case INTEGER:
+            fprintf(stderr, "Cannot perform operation on Object of kind INTEGER\n");
+            return -1;
+        case FLOAT:
+            fprintf(stderr, "Cannot perform operation on Object of kind FLOAT\n");
+            return -1;
+        case STRING:
+            return obj -> data.v_string.length;
+        case COLLECTION:
+            return  obj -> data.v_collection.length;
+        case DICT:
+        case SET:
+            return obj -> data.v_dict.length;
+        case DEQUE:
+            return obj -> data.v_deque.length;
+        case PLIST:
+            return obj -> data.v_plist.length;
+        default:
+            fprintf(stderr, "Error: Unknown object kind detected\n");
+            return -1;
+    }
+
+}
+
+
+
+int collection_append(object_t *collection, object_t *item){
+    if(collection == NULL || item == NULL){
+        fprintf(stderr, "Cannot perform operation on null object\n");
+        return -1;
+    }
+    if (object_kind(collection) != COLLECTION){
+        fprintf(stderr, "Error: Can't perform append operation on non_collection kind\n");
+        return -1;
+    }
+    if (!container_can_hold(collection, item)){
+        return -1;
+    }
+    if (collection_make_unique(collection) != 0 || collection_fit(collection, item) != 0){
+        return -1;
+    }
+    if (collection -> data.v_collection.capacity == collection -> data.v_collection.length){
+        size_t new_cap = collection -> data.v_collection.capacity * 2;
+        object_t **temp = collection_store_resize(collection, new_cap);
+
+        if (temp == NULL){
+            return -1;
+        }
+
+        collection -> data.v_collection.data = temp;
+        collection -> data.v_collection.capacity = new_cap;
+
+    }
+    collection_put(collection, collection -> data.v_collection.length, item);
+
+    collection -> data.v_collection.length++;
+    
+
+    return 0;
+}
+
+int collection_set(object_t *collection, size_t index, object_t *value){
+    if (collection == NULL || value == NULL){
+        fprintf(stderr, "Unable to perform operation with null values\n");
+        return -1;
+    }
+
+    if (object_kind(collection) != COLLECTION){
+        fprintf(stderr, "Cannot perform operation on non_collection kind\n");
+        return -1;
+    }
+
+    if (index >= collection -> data.v_collection.length){
+        fprintf(stderr, "Index specified is out of bounds\n");
+        return -1;
+    }
+    if (!container_can_hold(collection, value)){
+        return -1;
+    }
+    if (collection_make_unique(collection) != 0 || collection_fit(collection, value) != 0){
+        return -1;
+    }
+
+    object_free(collection_item(collection, index));
+
+    collection_put(collection, index, value);
+    return 0;
+}
+
+
+object_t *collection_access(object_t *collection, size_t index){
+    if (collection == NULL){
+        fprintf(stderr, "Unable to perform operation with null values\n");
+        return NULL;
+    }
+
+    if (object_kind(collection) != COLLECTION){
+        fprintf(stderr, "Cannot perform operation on non_collection kind\n");
+        return NULL;
+    }
+
+    if (collection -> data.v_collection.stack == true){
+        fprintf(stderr, "Cannot perform operation on stack kind\n");
+        return NULL;
+    }
+
+    if (index >= collection -> data.v_collection.length){
+        fprintf(stderr, "Index specified is out of bounds\n");
+        return NULL;
+    }
+
+    return collection_item(collection, index);
+
+}
+
+//Like collection_access, but the returned item may be modified in place. The
+//collection's item array is unshared first, and a nested collection that is still
+//shared with someone else is replaced by a private clone of it.
+object_t *collection_access_mut(object_t *collection, size_t index){
+    object_t *item = collection_access(collection, index);
+    if (item == NULL || collection_make_unique(collection) != 0){
+        return NULL;
+    }
+    if (object_kind(item) == COLLECTION && REFCOUNT_LOAD(item -> refcount) > 1){
+        object_t *own = collection_share(item);
+        if (own == NULL){
+            return NULL;
+        }
+        object_free(item);
+        collection -> data.v_collection.data[index] = own;
+        item = own;
+    }
+    return item;
+}
+
+
+int is_empty(object_t *collection_stack){
+    if (object_kind(collection_stack) != COLLECTION){
+        fprintf(stderr, "Cannot perform empty function on non_collection kind");
+        return -1;
+    }
+    if (collection_stack == NULL){
+        fprintf(stderr, "Cannot perform empty function on null object\n");
+        return -1;
+    }
+
+    if (collection_stack -> data.v_collection.stack == false){
+        fprintf(stderr, "Cannot perform empty function on non_stack kind");
+        return -1;
+    }
+
+    if (collection_stack -> data.v_collection.length == 0){
+        return 1;
+    }
+    return 0;
+}
+
+
+object_t *collection_pop(object_t *collection){
+    if (collection == NULL){
+        return NULL;
+    }   
+    if (object_kind(collection) != COLLECTION) {
+        fprintf(stderr, "Error: Cannot pop from non-collection\n");
+        return NULL;
+    }
+
+    if (collection -> data.v_collection.length == 0){
+        fprintf(stderr, "Error: Cannot pop from empty collection\n");
+        return NULL;
+    }
+    if (collection_make_unique(collection) != 0){
+        return NULL;
+    }
+
+    size_t top_index = collection -> data.v_collection.length - 1;
+    object_t *popped_item = collection_item(collection, top_index);
+
+    if (collection -> data.v_collection.items == ITEMS_BOXED){
+        collection -> data.v_collection.data[top_index] = NULL;
+    }
+    collection -> data.v_collection.length--;
+
+    return popped_item;
+}
+
+object_t *stack_peek(object_t *collection){
+    if (collection == NULL){
+        return NULL;
+    }
+
+    if (object_kind(collection) != COLLECTION) {
+        fprintf(stderr, "Error: Cannot peek from non-collection\n");
+        return NULL;
+    }
+
+    if ( collection -> data.v_collection.stack == false){
+        fprintf(stderr, "Cannot perform peek operation on non_stack kind");
+        return NULL;
+    }
+
+    if (collection -> data.v_collection.length == 0){
+        fprintf(stderr, "Error: Cannot peek from empty collection\n");
+        return NULL;
+    }
+
+    return collection_item(collection, collection -> data.v_collection.length - 1);
+
+
+
+}
+
+
+// Bulk operations. These check their arguments once and then move whole runs of
+// items with memcpy/memmove, instead of going through collection_append per item.
+// Items copied in from another collection are retained, not cloned, just like the
+// copy-on-write paths; the source collection is left untouched.
+
+//Makes room for at least 'capacity' items without changing the length
+int collection_reserve(object_t *collection, size_t capacity){
+    if (collection == NULL){
+        fprintf(stderr, "Cannot perform operation on null object\n");
+        return -1;
+    }
+    if (object_kind(collection) != COLLECTION){
+        fprintf(stderr, "Cannot perform operation on non_collection kind\n");
+        return -1;
+    }
+    if (collection_make_unique(collection) != 0){
+        return -1;
+    }
+    if (capacity <= collection -> data.v_collection.capacity){
+        return 0;
+    }
+    object_t **temp = collection_store_resize(collection, capacity);
+    if (temp == NULL){
+        return -1;
+    }
+    collection -> data.v_collection.data = temp;
+    collection -> data.v_collection.capacity = capacity;
+    return 0;
+}
+
+//Gives back unused capacity, keeping room for at least one item
+int collection_shrink_to_fit(object_t *collection){
+    if (collection == NULL){
+        fprintf(stderr, "Cannot perform operation on null object\n");
+        return -1;
+    }
+    if (object_kind(collection) != COLLECTION){
+        fprintf(stderr, "Cannot perform operation on non_collection kind\n");
+        return -1;
+    }
+    size_t capacity = collection -> data.v_collection.length > 0 ? collection -> data.v_collection.length : 1;
+    if (capacity == collection -> data.v_collection.capacity){
+        return 0;
+    }
+    if (collection_make_unique(collection) != 0){
+        return -1;
+    }
+    object_t **temp = collection_store_resize(collection, capacity);
+    if (temp == NULL){
+        return -1;
+    }
+    collection -> data.v_collection.data = temp;
+    collection -> data.v_collection.capacity = capacity;
+    return 0;
+}
+
+//Replaces the 'remove' items starting at 'index' with every item of 'insert' (which may be NULL to only remove).
+//The removed items are freed. 'insert' may be the collection itself.
+int collection_splice(object_t *collection, size_t index, size_t remove, object_t *insert){
+    if (collection == NULL){
+        fprintf(stderr, "Cannot perform operation on null object\n");
+        return -1;
+    }
+    if (object_kind(collection) != COLLECTION || (insert != NULL && object_kind(insert) != COLLECTION)){
+        fprintf(stderr, "Cannot perform operation on non_collection kind\n");
+        return -1;
+    }
+    size_t length = collection -> data.v_collection.length;
+    if (index > length || remove > length - index){
+        fprintf(stderr, "Index specified is out of bounds\n");
+        return -1;
+    }
+    //splicing a collection into itself reads from a snapshot of its current items
+    object_t *source = insert == collection ? collection_share(collection) : object_retain(insert);
+    if (insert != NULL && source == NULL){
+        return -1;
+    }
+    size_t count = source != NULL ? source -> data.v_collection.length : 0;
+    size_t new_length = length - remove + count;
+    for (size_t i = 0; source != NULL && source -> data.v_collection.items == ITEMS_BOXED && i < count; i++){
+        if (!container_can_hold(collection, source -> data.v_collection.data[i])){
+            object_free(source);
+            return -1;
+        }
+    }
+
+    int status = collection_make_unique(collection);
+    if (status == 0 && count > 0 && source -> data.v_collection.items != collection -> data.v_collection.items){
+        //only a collection with no items left over can take on the source's layout
+        if (new_length == count && collection -> data.v_collection.items == ITEMS_BOXED && source -> data.v_collection.items != ITEMS_BOXED){
+            object_t **store = collection_store_alloc(collection, collection -> data.v_collection.capacity, source -> data.v_collection.items);
+            status = store == NULL ? -1 : 0;
+            if (status == 0){
+                for (size_t i = 0; i < length; i++){
+                    object_free(collection -> data.v_collection.data[i]);
+                }
+                collection -> data.v_collection.length = 0;
+                collection_store_replace(collection, store, source -> data.v_collection.items);
+                length = 0;
+                remove = 0;
+            }
+        }
+        else {
+            status = collection_unpack(collection);
+        }
+    }
+    if (status == 0 && new_length > collection -> data.v_collection.capacity){
+        size_t new_cap = collection -> data.v_collection.capacity * 2;
+        status = collection_reserve(collection, new_cap > new_length ? new_cap : new_length);
+    }
+    if (status != 0){
+        object_free(source);
+        return -1;
+    }
+
+    uint8_t items = collection -> data.v_collection.items;
+    size_t item_size = collection_item_size(items);
+    char *base = (char *)collection -> data.v_collection.data;
+    if (items == ITEMS_BOXED){
+        for (size_t i = index; i < index + remove; i++){
+            object_free(collection -> data.v_collection.data[i]);
+        }
+    }
+    //shift the tail once, then drop the new items into the gap
+    memmove(base + item_size * (index + count), base + item_size * (index + remove), item_size * (length - index - remove));
+    if (count > 0 && source -> data.v_collection.items == items){
+        memcpy(base + item_size * index, source -> data.v_collection.data, item_size * count);
+        if (items == ITEMS_BOXED){
+            for (size_t i = index; i < index + count; i++){
+                object_retain(collection -> data.v_collection.data[i]);
+            }
+        }
+    }
+    else {
+        for (size_t i = 0; i < count; i++){
+            collection_put(collection, index + i, object_retain(collection_item(source, i)));
+        }
+    }
+    collection -> data.v_collection.length = new_length;
+    object_free(source);
+    return 0;
+}
+
+//Appends every item of 'other' to 'collection', growing it at most once
+int collection_extend(object_t *collection, object_t *other){
+    if (collection == NULL || other == NULL){
+        fprintf(stderr, "Cannot perform operation on null object\n");
+        return -1;
+    }
+    if (object_kind(collection) != COLLECTION){
+        fprintf(stderr, "Error: Can't perform extend operation on non_collection kind\n");
+        return -1;
+    }
+    return collection_splice(collection, collection -> data.v_collection.length, 0, other);
+}
+
+// ======= SLICE VIEWS =======
+// object_slice takes part of a STRING, VECTOR or COLLECTION in O(1): the result is
+// an ordinary object of the same kind whose chars, coords or item array point into
+// a base object it keeps alive, flagged OBJ_FLAG_VIEW with the base in a slot
+// right after the payload. Everything that reads the payload (collection_access,
+// object_length, print_object, the arithmetic operators, hashing and comparison)
+// works on a view unchanged. Strings and vectors are never mutated, so they view
+// the sliced object itself. A collection view looks into a collection_share
+// snapshot instead, so writes to the sliced collection copy its array first and
+// the view keeps seeing the items as they were; writing to the view itself gives
+// it a private copy of its window (collection_detach). Slicing a view views the
+// same base. Slices short enough to be stored inline are plain copies, as are
+// slices whose base a new object may not hold on to (arena and collector rules).
+
+static object_t *string_slice(object_t *str, size_t start, size_t length){
+    if (string_flatten(str) == NULL){
+        return NULL;
+    }
+    object_t *base = view_base(str) != NULL ? view_base(str) : str;
+    if (length <= STRING_INLINE_MAX || !view_can_hold(base)){
+        return new_object_string_n(str -> data.v_string.chars + start, length);
+    }
+    object_t *view = object_new(OBJECT_SIZE_OF(v_string) + sizeof(object_t *), STRING);
+    if (view == NULL){
+        return NULL;
+    }
+    view -> flags |= OBJ_FLAG_VIEW;
+    view -> data.v_string.length = length;
+    view -> data.v_string.capacity = length;
+    view -> data.v_string.chars = str -> data.v_string.chars + start;
+    view -> data.v_string.rope = NULL;
+    *view_base_slot(view) = object_retain(base);
+    return view;
+}
+
+static object_t *vector_slice(object_t *vec, size_t start, size_t length){
+    object_t *base = view_base(vec) != NULL ? view_base(vec) : vec;
+    if (length <= VECTOR_INLINE_MAX || !view_can_hold(base)){
+        return new_object_vector(length, vec -> data.v_vector.coords + start);
+    }
+    object_t *view = object_new(OBJECT_SIZE_OF(v_vector) + sizeof(object_t *), VECTOR);
+    if (view == NULL){
+        return NULL;
+    }
+    view -> flags |= OBJ_FLAG_VIEW;
+    view -> data.v_vector.dimensions = length;
+    view -> data.v_vector.coords = vec -> data.v_vector.coords + start;
+    *view_base_slot(view) = object_retain(base);
+    return view;
+}
+
+static object_t *collection_slice(object_t *collection, size_t start, size_t length){
+    if (collection -> data.v_collection.stack){
+        fprintf(stderr, "object_slice: can only slice non-stack collections (lists)\n");
+        return NULL;
+    }
+    uint8_t items = collection -> data.v_collection.items;
+    object_t *base = view_base(collection);
+    if (!view_can_hold(base != NULL ? base : collection)){
+        //an arena or collected array cannot back a view made here
+        object_t *copy = collection_new(length > 0 ? length : 1, false, items);
+        for (size_t i = 0; copy != NULL && i < length; i++){
+            collection_put(copy, i, object_retain(collection_item(collection, start + i)));
+        }
+        if (copy != NULL){
+            copy -> data.v_collection.length = length;
+        }
+        return copy;
+    }
+    //a snapshot pins the items as they are now: a view's window already lies in
+    //its base's array, a plain collection is pinned by a header sharing its array
+    char *first = (char *)collection -> data.v_collection.data;
+    if (base != NULL){
+        object_retain(base);
+    }
+    else {
+        base = collection_share(collection);
+        if (base == NULL){
+            return NULL;
+        }
+        first = (char *)base -> data.v_collection.data;
+    }
+    object_t *view = object_new(OBJECT_SIZE_OF(v_collection) + sizeof(object_t *), COLLECTION);
+    if (view == NULL){
+        object_free(base);
+        return NULL;
+    }
+    view -> flags |= OBJ_FLAG_VIEW;
+    view -> data.v_collection.length = length;
+    view -> data.v_collection.data = (object_t **)(void *)(first + collection_item_size(items) * start);
+    view -> data.v_collection.capacity = length;
+    view -> data.v_collection.stack = false;
+    view -> data.v_collection.items = items;
+    *view_base_slot(view) = base;
+    return view;
+}
+
+//The 'length' items, bytes or coords of 'obj' starting at 'start', as a new reference
+object_t *object_slice(object_t *obj, size_t start, size_t length){
+    if (obj == NULL){
+        fprintf(stderr, "Cannot perform operation on null object\n");
+        return NULL;
+    }
+    size_t total;
+    switch (object_kind(obj)){
+        case STRING:
+            total = obj -> data.v_string.length;
+            break;
+        case VECTOR:
+            total = obj -> data.v_vector.dimensions;
+            break;
+        case COLLECTION:
+            total = obj -> data.v_collection.length;
+            break;
+        default:
+            fprintf(stderr, "Cannot perform slice on kinds other than STRING, VECTOR and COLLECTION\n");
+            return NULL;
+    }
+    if (start > total || length > total - start){
+        fprintf(stderr, "Slice specified is out of bounds\n");
+        return NULL;
+    }
+    switch (object_kind(obj)){
+        case STRING:
+            return string_slice(obj, start, length);
+        case VECTOR:
+            return vector_slice(obj, start, length);
+        default:
+            return collection_slice(obj, start, length);
+    }
+}
+
+// ======= HASHING =======
+// object_hash is structural and agrees with object_equals: equal objects hash
+// equal. Collections hash their items in order, dicts their entries in any order.
+static inline uint64_t hash_mix(uint64_t x){
+    //splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static inline uint64_t hash_combine(uint64_t seed, uint64_t value){
+    return hash_mix(seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+}
+
+uint64_t object_hash(object_t *obj){
+    if (obj == NULL){
+        return 0;
+    }
+    object_kind_t kind = object_kind(obj);
+    switch (kind){
+        case INTEGER:
+            return hash_mix((uint64_t)(uint32_t)object_int(obj) ^ ((uint64_t)INTEGER << 32));
+        case FLOAT:{
+            //0.0 and -0.0 compare equal, so they have to hash alike
+            float value = object_float(obj) == 0.0f ? 0.0f : object_float(obj);
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            return hash_mix((uint64_t)bits ^ ((uint64_t)FLOAT << 32));
+        }
+        case STRING:
+            if (string_flatten(obj) == NULL){
+                return 0;
+            }
+            return string_hash(obj -> data.v_string.chars, obj -> data.v_string.length);
+        case COLLECTION:{
+            uint64_t hash = hash_mix(COLLECTION);
+            for (size_t i = 0; i < obj -> data.v_collection.length; i++){
+                hash = hash_combine(hash, object_hash(collection_item(obj, i)));
+            }
+            return hash;
+        }
+        case DEQUE:{
+            uint64_t hash = hash_mix(DEQUE);
+            for (size_t i = 0; i < obj -> data.v_deque.length; i++){
+                hash = hash_combine(hash, object_hash(deque_item(obj, i)));
+            }
+            return hash;
+        }
+        case PLIST:{
+            uint64_t hash = hash_mix(PLIST);
+            for (size_t i = 0; i < obj -> data.v_plist.length; i++){
+                hash = hash_combine(hash, object_hash(plist_item(obj, i)));
+            }
+            return hash;
+        }
+        case VECTOR:
+            return hash_combine(VECTOR, string_hash((const char *)obj -> data.v_vector.coords, sizeof(float) * obj -> data.v_vector.dimensions));
+        case MATRIX:{
+            uint64_t hash = hash_combine(hash_mix(MATRIX), obj -> data.v_matrix.rows);
+            return hash_combine(hash, string_hash((const char *)obj -> data.v_matrix.values,
+                                                  sizeof(float) * obj -> data.v_matrix.rows * obj -> data.v_matrix.cols));
+        }
+        case DICT:
+        case SET:{
+            //a plain sum, so the slot order does not matter
+            uint64_t sum = 0;
+            for (size_t i = 0; i < obj -> data.v_dict.capacity; i++){
+                dict_slot_t *slot = &obj -> data.v_dict.slots[i];
+                if (slot -> key != NULL){
+                    sum += hash_combine(object_hash(slot -> key), object_hash(slot -> value));
+                }
+            }
+            return hash_combine(hash_mix(kind), sum);
+        }
+        default:
+            return hash_mix(kind);
+    }
+}
+
+// ======= DICTS =======
+// A DICT is an open-addressing table with Robin Hood probing: every slot records
+// how far its key sits from its home slot, an insert takes the place of any key
+// closer to home than itself, and a lookup stops as soon as it meets such a key.
+// That keeps probe lengths short and even at the 3/4 load the table grows at.
+// Deletes shift the following run back one slot, so there are no tombstones.
+// Keys are compared with object_equals after a hash check. A COLLECTION key is
+// stored as a copy-on-write snapshot, so changing the list it came from later
+// cannot move it. DICTs, SETs and DEQUEs cannot be keys. A SET is the same table with
+// every value NULL.
+#define DICT_MIN_CAPACITY 8
+
+static dict_slot_t *dict_slots_alloc(object_t *dict, size_t capacity){
+    if (dict -> flags & OBJ_FLAG_ARENA){
+        if (active_arena == NULL){
+            fprintf(stderr, "Cannot grow an arena dict outside of its arena\n");
+            return NULL;
+        }
+        dict_slot_t *slots = arena_alloc(active_arena, sizeof(dict_slot_t) * capacity, sizeof(void *));
+        if (slots != NULL){
+            memset(slots, 0, sizeof(dict_slot_t) * capacity);
+        }
+        return slots;
+    }
+    return calloc(capacity, sizeof(dict_slot_t));
+}
+
+static void dict_slots_free(object_t *dict, dict_slot_t *slots){
+    if (!(dict -> flags & OBJ_FLAG_ARENA)){
+        free(slots);
+    }
+}
+
+static object_t *dict_new(size_t capacity, object_kind_t kind){
+    size_t slots = DICT_MIN_CAPACITY;
+    //room for 'capacity' keys below the load limit
+    while (slots / 4 * 3 < capacity){
+        slots *= 2;
+    }
+    object_t *new_obj = object_new(OBJECT_SIZE_OF(v_dict), kind);
+    if (new_obj == NULL){
+        return NULL;
+    }
+    new_obj -> data.v_dict.length = 0;
+    new_obj -> data.v_dict.capacity = slots;
+    new_obj -> data.v_dict.slots = dict_slots_alloc(new_obj, slots);
+    if (new_obj -> data.v_dict.slots == NULL){
+        object_dealloc(new_obj, OBJECT_SIZE_OF(v_dict));
+        return NULL;
+    }
+    return new_obj;
+}
+
+object_t *new_object_dict(size_t capacity){
+    return dict_new(capacity, DICT);
+}
+
+//Slot holding 'key', or NULL
+static dict_slot_t *dict_find(object_t *dict, object_t *key, uint32_t hash){
+    size_t mask = dict -> data.v_dict.capacity - 1;
+    size_t index = hash & mask;
+    for (uint32_t probe = 0; ; probe++){
+        dict_slot_t *slot = &dict -> data.v_dict.slots[index];
+        if (slot -> key == NULL || slot -> probe < probe){
+            return NULL;
+        }
+        if (slot -> hash == hash && object_equals(slot -> key, key)){
+            return slot;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+//Places an entry whose key is not in the table yet. There must be a free slot.
+static void dict_place(dict_slot_t *slots, size_t capacity, dict_slot_t entry){
+    size_t mask = capacity - 1;
+    size_t index = entry.hash & mask;
+    entry.probe = 0;
+    while (slots[index].key != NULL){
+        if (slots[index].probe < entry.probe){
+            //the resident is closer to home, it moves on instead
+            dict_slot_t resident = slots[index];
+            slots[index] = entry;
+            entry = resident;
+        }
+        index = (index + 1) & mask;
+        entry.probe++;
+    }
+    slots[index] = entry;
+}
+
+static int dict_grow(object_t *dict){
+    size_t capacity = dict -> data.v_dict.capacity * 2;
+    dict_slot_t *slots = dict_slots_alloc(dict, capacity);
+    if (slots == NULL){
+        return -1;
+    }
+    dict_slot_t *old = dict -> data.v_dict.slots;
+    for (size_t i = 0; i < dict -> data.v_dict.capacity; i++){
+        if (old[i].key != NULL){
+            dict_place(slots, capacity, old[i]);
+        }
+    }
+    dict_slots_free(dict, old);
+    dict -> data.v_dict.slots = slots;
+    dict -> data.v_dict.capacity = capacity;
+    return 0;
+}
+
+static bool dict_check(object_t *dict, object_t *key, object_kind_t kind){
+    if (dict == NULL || key == NULL){
+        fprintf(stderr, "Cannot perform operation on null object\n");
+        return false;
+    }
+    if (object_kind(dict) != kind){
+        fprintf(stderr, "Cannot perform operation on %s kind\n", kind == DICT ? "non_dict" : "non_set");
+        return false;
+    }
+    return true;
+}
+
+//Adds a key that is not in the table yet. Takes ownership of key and value on success.
+static int dict_insert(object_t *dict, object_t *key, object_t *value, uint32_t hash){
+    if (!container_can_hold(dict, key) || (value != NULL && !container_can_hold(dict, value))){
+        return -1;
+    }
+    if (object_kind(key) == DICT || object_kind(key) == SET || object_kind(key) == DEQUE){
+        fprintf(stderr, "Cannot use an Object of kind %s as a key\n", object_kind(key) == DICT ? "DICT" : object_kind(key) == SET ? "SET" : "DEQUE");
+        return -1;
+    }
+    if (dict -> data.v_dict.length + 1 > dict -> data.v_dict.capacity / 4 * 3 && dict_grow(dict) != 0){
+        return -1;
+    }
+    if (object_kind(key) == COLLECTION){
+        object_t *snapshot = collection_share(key);
+        if (snapshot == NULL){
+            return -1;
+        }
+        object_free(key);
+        key = snapshot;
+    }
+    dict_slot_t entry = {key, value, hash, 0};
+    dict_place(dict -> data.v_dict.slots, dict -> data.v_dict.capacity, entry);
+    dict -> data.v_dict.length++;
+    return 0;
+}
+
+//Frees the entry in 'slot' and closes the gap it leaves
+static void dict_delete(object_t *dict, dict_slot_t *slot){
+    object_free(slot -> key);
+    object_free(slot -> value);
+
+    //pull the rest of the run one slot closer to home
+    size_t mask = dict -> data.v_dict.capacity - 1;
+    size_t hole = (size_t)(slot - dict -> data.v_dict.slots);
+    size_t next = (hole + 1) & mask;
+    while (dict -> data.v_dict.slots[next].key != NULL && dict -> data.v_dict.slots[next].probe > 0){
+        dict -> data.v_dict.slots[hole] = dict -> data.v_dict.slots[next];
+        dict -> data.v_dict.slots[hole].probe--;
+        hole = next;
+        next = (next + 1) & mask;
+    }
+    memset(&dict -> data.v_dict.slots[hole], 0, sizeof(dict_slot_t));
+    dict -> data.v_dict.length--;
+}
+
+//Value stored under 'key' (borrowed, like collection_access), or NULL if there is none
+object_t *dict_get(object_t *dict, object_t *key){
+    if (!dict_check(dict, key, DICT)){
+        return NULL;
+    }
+    dict_slot_t *slot = dict_find(dict, key, (uint32_t)object_hash(key));
+    return slot == NULL ? NULL : slot -> value;
+}
+
+//Stores 'value' under 'key'. Takes ownership of both on success, like collection_append does of its item.
+int dict_set(object_t *dict, object_t *key, object_t *value){
+    if (!dict_check(dict, key, DICT)){
+        return -1;
+    }
+    if (value == NULL){
+        fprintf(stderr, "Cannot perform operation on null object\n");
+        return -1;
+    }
+    uint32_t hash = (uint32_t)object_hash(key);
+    dict_slot_t *slot = dict_find(dict, key, hash);
+    if (slot != NULL){
+        if (!container_can_hold(dict, value)){
+            return -1;
+        }
+        //the stored key stays, it is equal anyway
+        object_free(slot -> value);
+        slot -> value = value;
+        object_free(key);
+        return 0;
+    }
+    return dict_insert(dict, key, value, hash);
+}
+
+//Removes 'key' and frees it along with its value. Returns 1 if it was there, 0 if not, -1 on error.
+int dict_remove(object_t *dict, object_t *key){
+    if (!dict_check(dict, key, DICT)){
+        return -1;
+    }
+    dict_slot_t *slot = dict_find(dict, key, (uint32_t)object_hash(key));
+    if (slot == NULL){
+        return 0;
+    }
+    dict_delete(dict, slot);
+    return 1;
+}
+
+//New dict (or set) with the same entries, keys and values retained
+static object_t *dict_copy(object_t *dict){
+    object_t *copy = object_new(OBJECT_SIZE_OF(v_dict), object_kind(dict));
+    if (copy == NULL){
+        return NULL;
+    }
+    size_t capacity = dict -> data.v_dict.capacity;
+    copy -> data.v_dict.length = dict -> data.v_dict.length;
+    copy -> data.v_dict.capacity = capacity;
+    copy -> data.v_dict.slots = dict_slots_alloc(copy, capacity);
+    if (copy -> data.v_dict.slots == NULL){
+        object_dealloc(copy, OBJECT_SIZE_OF(v_dict));
+        return NULL;
+    }
+    //same capacity, so every entry keeps its slot
+    memcpy(copy -> data.v_dict.slots, dict -> data.v_dict.slots, sizeof(dict_slot_t) * capacity);
+    for (size_t i = 0; i < capacity; i++){
+        if (copy -> data.v_dict.slots[i].key != NULL){
+            object_retain(copy -> data.v_dict.slots[i].key);
+            object_retain(copy -> data.v_dict.slots[i].value);
+        }
+    }
+    return copy;
+}
+
+// ======= SETS =======
+object_t *new_object_set(size_t capacity){
+    return dict_new(capacity, SET);
+}
+
+//Adds 'item', taking ownership of it. Returns 1 if it was added, 0 if an equal item
+//was already there (then 'item' is freed), -1 on error (then the caller keeps it).
+int set_add(object_t *set, object_t *item){
+    if (!dict_check(set, item, SET)){
+        return -1;
+    }
+    uint32_t hash = (uint32_t)object_hash(item);
+    if (dict_find(set, item, hash) != NULL){
+        object_free(item);
+        return 0;
+    }
+    return dict_insert(set, item, NULL, hash) == 0 ? 1 : -1;
+}
+
+bool set_contains(object_t *set, object_t *item){
+    if (!dict_check(set, item, SET)){
+        return false;
+    }
+    return dict_find(set, item, (uint32_t)object_hash(item)) != NULL;
+}
+
+//Removes 'item'. Returns 1 if it was there, 0 if not, -1 on error.
+int set_remove(object_t *set, object_t *item){
+    if (!dict_check(set, item, SET)){
+        return -1;
+    }
+    dict_slot_t *slot = dict_find(set, item, (uint32_t)object_hash(item));
+    if (slot == NULL){
+        return 0;
+    }
+    dict_delete(set, slot);
+    return 1;
+}
+
+//Set of the distinct items of a collection, retained
+object_t *collection_to_set(object_t *collection){
+    if (collection == NULL || object_kind(collection) != COLLECTION){
+        fprintf(stderr, "Cannot perform operation on non_collection kind\n");
+        return NULL;
+    }
+    object_t *set = new_object_set(collection -> data.v_collection.length);
+    for (size_t i = 0; set != NULL && i < collection -> data.v_collection.length; i++){
+        object_t *item = collection_item(collection, i);
+        if (set_add(set, object_retain(item)) < 0){
+            object_free(item);
+            object_free(set);
+            set = NULL;
+        }
+    }
+    return set;
+}
+
+//Linear membership test. For many lookups in one list build a SET with collection_to_set once.
+bool collection_contains(object_t *collection, object_t *item){
+    if (collection == NULL || item == NULL || object_kind(collection) != COLLECTION){
+        fprintf(stderr, "Cannot perform operation on non_collection kind\n");
+        return false;
+    }
+    size_t length = collection -> data.v_collection.length;
+    uint8_t items = collection -> data.v_collection.items;
+    if (items != ITEMS_BOXED){
+        //packed values: compare raw numbers, no objects involved
+        if (collection_items_for(item) != items){
+            return false;
+        }
+        for (size_t i = 0; i < length; i++){
+            if (items == ITEMS_INT ? collection_ints(collection)[i] == object_int(item)
+                                   : collection_floats(collection)[i] == object_float(item)){
+                return true;
+            }
+        }
+        return false;
+    }
+    for (size_t i = 0; i < length; i++){
+        if (object_equals(collection -> data.v_collection.data[i], item)){
+            return true;
+        }
+    }
+    return false;
+}
+
+//New list with the first occurrence of every distinct item, in order. O(n) through a scratch SET.
+object_t *collection_unique(object_t *collection){
+    if (collection == NULL || object_kind(collection) != COLLECTION){
+        fprintf(stderr, "Cannot perform operation on non_collection kind\n");
+        return NULL;
+    }
+    size_t length = collection -> data.v_collection.length;
+    object_t *seen = new_object_set(length);
+    object_t *unique = collection_new(length > 0 ? length : 1, collection -> data.v_collection.stack, collection -> data.v_collection.items);
+    if (seen == NULL || unique == NULL){
+        object_free(seen);
+        object_free(unique);
+        return NULL;
+    }
+    for (size_t i = 0; i < length; i++){
+        object_t *item = collection_item(collection, i);
+        int added = set_add(seen, object_retain(item));
+        if (added < 0){
+            object_free(item);
+        }
+        if (added < 0 || (added == 1 && collection_append(unique, object_retain(item)) != 0)){
+            object_free(seen);
+            object_free(unique);
+            return NULL;
+        }
+    }
+    object_free(seen);
+    return unique;
+}
+
+//Retained SET view of a SET or COLLECTION operand
+static object_t *set_operand(object_t *obj){
+    if (obj != NULL && object_kind(obj) == SET){
+        return object_retain(obj);
+    }
+    if (obj != NULL && object_kind(obj) == COLLECTION){
+        return collection_to_set(obj);
+    }
+    fprintf(stderr, "Cannot perform set operation on non_set kind\n");
+    return NULL;
+}
+
+typedef enum {
+    SET_UNION,
+    SET_INTERSECTION,
+    SET_DIFFERENCE
+} set_op_t;
+
+//a | b, a & b or a - b as a new SET. Either side may also be a COLLECTION.
+static object_t *set_combine(object_t *a, object_t *b, set_op_t op){
+    object_t *left = set_operand(a);
+    object_t *right = set_operand(b);
+    object_t *result = NULL;
+    if (left != NULL && right != NULL){
+        if (op == SET_UNION){
+            result = dict_copy(left);
+        }
+        else {
+            result = new_object_set(op == SET_INTERSECTION && right -> data.v_dict.length < left -> data.v_dict.length
+                                    ? right -> data.v_dict.length : left -> data.v_dict.length);
+        }
+        //union walks the right side into a copy of the left, the others filter the left side
+        object_t *walked = op == SET_UNION ? right : left;
+        object_t *other = op == SET_UNION ? result : right;
+        for (size_t i = 0; result != NULL && i < walked -> data.v_dict.capacity; i++){
+            dict_slot_t *slot = &walked -> data.v_dict.slots[i];
+            if (slot -> key == NULL){
+                continue;
+            }
+            bool found = dict_find(other, slot -> key, slot -> hash) != NULL;
+            bool keep = op == SET_INTERSECTION ? found : !found;
+            if (keep && dict_insert(result, object_retain(slot -> key), NULL, slot -> hash) != 0){
+                object_free(slot -> key);
+                object_free(result);
+                result = NULL;
+            }
+        }
+    }
+    object_free(left);
+    object_free(right);
+    return result;
+}
+
+object_t *set_union(object_t *a, object_t *b){
+    return set_combine(a, b, SET_UNION);
+}
+
+object_t *set_intersection(object_t *a, object_t *b){
+    return set_combine(a, b, SET_INTERSECTION);
+}
+
+object_t *set_difference(object_t *a, object_t *b){
+    return set_combine(a, b, SET_DIFFERENCE);
+}
+
+// ======= DEQUES =======
+// A DEQUE keeps its items in a ring buffer: item i sits in slot
+// (head + i) & (capacity - 1), so pushing or popping at either end only moves
+// head or length, where removing the first item of a COLLECTION shifts all the
+// others down. The capacity is a power of two and doubles when the ring is full,
+// unrolling it to start at slot 0 of the new buffer, so pushes are amortized
+// O(1). The deque owns its items; cloning one copies the ring with the items
+// retained, and the VM copies a deque someone else still holds before changing it.
+#define DEQUE_MIN_CAPACITY 8
+
+static object_t **deque_items_alloc(object_t *deque, size_t capacity){
+    if (deque -> flags & OBJ_FLAG_ARENA){
+        if (active_arena == NULL){
+            fprintf(stderr, "Cannot grow an arena deque outside of its arena\n");
+            return NULL;
+        }
+        return arena_alloc(active_arena, sizeof(object_t *) * capacity, sizeof(void *));
+    }
+    return malloc(sizeof(object_t *) * capacity);
+}
+
+static void deque_items_free(object_t *deque, object_t **items){
+    if (!(deque -> flags & OBJ_FLAG_ARENA)){
+        free(items);
+    }
+}
+
+object_t *new_object_deque(size_t capacity){
+    size_t slots = DEQUE_MIN_CAPACITY;
+    while (slots < capacity){
+        slots *= 2;
+    }
+    object_t *new_obj = object_new(OBJECT_SIZE_OF(v_deque), DEQUE);
+    if (new_obj == NULL){
+        return NULL;
+    }
+    new_obj -> data.v_deque.head = 0;
+    new_obj -> data.v_deque.length = 0;
+    new_obj -> data.v_deque.capacity = slots;
+    new_obj -> data.v_deque.items = deque_items_alloc(new_obj, slots);
+    if (new_obj -> data.v_deque.items == NULL){
+        object_dealloc(new_obj, OBJECT_SIZE_OF(v_deque));
+        return NULL;
+    }
+    return new_obj;
+}
+
+static bool deque_check(object_t *deque){
+    if (deque == NULL){
+        fprintf(stderr, "Cannot perform operation on null object\n");
+        return false;
+    }
+    if (object_kind(deque) != DEQUE){
+        fprintf(stderr, "Cannot perform operation on non_deque kind\n");
+        return false;
+    }
+    return true;
+}
+
+//Doubles the ring, moving the items to the start of the new buffer in order
+static int deque_grow(object_t *deque){
+    size_t capacity = deque -> data.v_deque.capacity * 2;
+    object_t **items = deque_items_alloc(deque, capacity);
+    if (items == NULL){
+        return -1;
+    }
+    size_t length = deque -> data.v_deque.length;
+    size_t head = deque -> data.v_deque.head;
+    size_t first = deque -> data.v_deque.capacity - head < length ? deque -> data.v_deque.capacity - head : length;
+    //the run from head to the end of the old buffer, then whatever wrapped around
+    memcpy(items, deque -> data.v_deque.items + head, sizeof(object_t *) * first);
+    memcpy(items + first, deque -> data.v_deque.items, sizeof(object_t *) * (length - first));
+    deque_items_free(deque, deque -> data.v_deque.items);
+    deque -> data.v_deque.items = items;
+    deque -> data.v_deque.capacity = capacity;
+    deque -> data.v_deque.head = 0;
+    return 0;
+}
+
+//Adds 'item' after the last item. Takes ownership of it on success.
+int deque_push_back(object_t *deque, object_t *item){
+    if (!deque_check(deque)){
+        return -1;
+    }
+    if (item == NULL){
+        fprintf(stderr, "Cannot perform operation on null object\n");
+        return -1;
+    }
+    if (!container_can_hold(deque, item)){
+        return -1;
+    }
+    if (deque -> data.v_deque.length == deque -> data.v_deque.capacity && deque_grow(deque) != 0){
+        return -1;
+    }
+    size_t mask = deque -> data.v_deque.capacity - 1;
+    deque -> data.v_deque.items[(deque -> data.v_deque.head + deque -> data.v_deque.length) & mask] = item;
+    deque -> data.v_deque.length++;
+    return 0;
+}
+
+//Adds 'item' before the first item. Takes ownership of it on success.
+int deque_push_front(object_t *deque, object_t *item){
+    if (!deque_check(deque)){
+        return -1;
+    }
+    if (item == NULL){
+        fprintf(stderr, "Cannot perform operation on null object\n");
+        return -1;
+    }
+    if (!container_can_hold(deque, item)){
+        return -1;
+    }
+    if (deque -> data.v_deque.length == deque -> data.v_deque.capacity && deque_grow(deque) != 0){
+        return -1;
+    }
+    size_t mask = deque -> data.v_deque.capacity - 1;
+    deque -> data.v_deque.head = (deque -> data.v_deque.head - 1) & mask;
+    deque -> data.v_deque.items[deque -> data.v_deque.head] = item;
+    deque -> data.v_deque.length++;
+    return 0;
+}
+
+//Removes the last item and hands it to the caller, like collection_pop
+object_t *deque_pop_back(object_t *deque){
+    if (!deque_check(deque)){
+        return NULL;
+    }
+    if (deque -> data.v_deque.length == 0){
+        fprintf(stderr, "Error: Cannot pop from empty deque\n");
+        return NULL;
+    }
+    deque -> data.v_deque.length--;
+    return deque_item(deque, deque -> data.v_deque.length);
+}
+
+//Removes the first item and hands it to the caller
+object_t *deque_pop_front(object_t *deque){
+    if (!deque_check(deque)){
+        return NULL;
+    }
+    if (deque -> data.v_deque.length == 0){
+        fprintf(stderr, "Error: Cannot pop from empty deque\n");
+        return NULL;
+    }
+    object_t *item = deque -> data.v_deque.items[deque -> data.v_deque.head];
+    deque -> data.v_deque.head = (deque -> data.v_deque.head + 1) & (deque -> data.v_deque.capacity - 1);
+    deque -> data.v_deque.length--;
+    return item;
+}
+
+//Item 'index' counted from the front (borrowed, like collection_access)
+object_t *deque_access(object_t *deque, size_t index){
+    if (!deque_check(deque)){
+        return NULL;
+    }
+    if (index >= deque -> data.v_deque.length){
+        fprintf(stderr, "Index specified is out of bounds\n");
+        return NULL;
+    }
+    return deque_item(deque, index);
+}
+
+//New deque with the same items, retained
+static object_t *deque_copy(object_t *deque){
+    size_t length = deque -> data.v_deque.length;
+    object_t *copy = new_object_deque(length);
+    if (copy == NULL){
+        return NULL;
+    }
+    for (size_t i = 0; i < length; i++){
+        copy -> data.v_deque.items[i] = object_retain(deque_item(deque, i));
+    }
+    copy -> data.v_deque.length = length;
+    return copy;
+}
+
+// ======= PERSISTENT LISTS =======
+// A PLIST never changes once built. plist_append, plist_set and plist_concat
+// return a new version and leave their operands intact, which makes keeping old
+// versions around (snapshots, undo) cheap: versions share all the structure they
+// have in common. The items sit in leaf chunks of up to PLIST_CHUNK items under
+// an AVL-balanced tree of concatenations, so a version differs from the one it
+// came from by the O(log n) nodes on the path to the change, plus one copied
+// leaf. plist_concat joins the two trees along the spine of the taller one, also
+// in O(log n), merging small leaves where they meet so that building a list by
+// appending keeps its leaves full. Nodes are reference counted like rope nodes.
+// In an arena they come out of the region, and the usual rule applies: arena
+// lists may hold heap nodes and items but not the other way round, so a new
+// version of an arena (or collected) list can only be made in its own mode.
+#define PLIST_CHUNK 32 //items in a leaf at most
+
+struct plist_node {
+    size_t refcount;
+    size_t length; //items below this node
+    uint32_t height; //0 for leaves
+    bool arena; //region memory, never freed
+    plist_node_t *left; //internal nodes only
+    plist_node_t *right;
+    object_t *items[]; //leaves only: 'length' owned items
+};
+
+static plist_node_t *plist_node_alloc(size_t items){
+    size_t bytes = sizeof(plist_node_t) + sizeof(object_t *) * items;
+    plist_node_t *node = active_arena != NULL ? arena_alloc(active_arena, bytes, sizeof(void *)) : malloc(bytes);
+    if (node == NULL){
+        return NULL;
+    }
+    node -> refcount = 1;
+    node -> length = 0;
+    node -> height = 0;
+    node -> arena = active_arena != NULL;
+    node -> left = NULL;
+    node -> right = NULL;
+    return node;
+}
+
+static inline plist_node_t *plist_node_retain(plist_node_t *node){
+    if (node != NULL && !node -> arena){
+        REFCOUNT_INCREMENT(node -> refcount);
+    }
+    return node;
+}
+
+static void plist_node_release(plist_node_t *node){
+    while (node != NULL && !node -> arena && REFCOUNT_DECREMENT(node -> refcount) == 0){
+        plist_node_t *right = node -> right;
+        for (size_t i = 0; node -> height == 0 && i < node -> length; i++){
+            object_free(node -> items[i]);
+        }
+        plist_node_release(node -> left);
+        free(node);
+        node = right; //walk the right spine without recursing
+    }
+}
+
+//Leaf holding 'count' items, retained
+static plist_node_t *plist_leaf(object_t **items, size_t count){
+    plist_node_t *leaf = plist_node_alloc(count);
+    if (leaf == NULL){
+        return NULL;
+    }
+    for (size_t i = 0; i < count; i++){
+        leaf -> items[i] = object_retain(items[i]);
+    }
+    leaf -> length = count;
+    return leaf;
+}
+
+//Internal node over two subtrees, taking over the caller's references to both.
+//Either may be NULL (a failed step further down), then so is the result.
+static plist_node_t *plist_branch(plist_node_t *left, plist_node_t *right){
+    plist_node_t *node = left != NULL && right != NULL ? plist_node_alloc(0) : NULL;
+    if (node == NULL){
+        plist_node_release(left);
+        plist_node_release(right);
+        return NULL;
+    }
+    node -> length = left -> length + right -> length;
+    node -> height = (left -> height > right -> height ? left -> height : right -> height) + 1;
+    node -> left = left;
+    node -> right = right;
+    return node;
+}
+
+//plist_branch, with a single or double rotation when the heights differ by two
+static plist_node_t *plist_balance(plist_node_t *left, plist_node_t *right){
+    if (left == NULL || right == NULL){
+        return plist_branch(left, right);
+    }
+    if (left -> height > right -> height + 1){
+        plist_node_t *outer = plist_node_retain(left -> left);
+        plist_node_t *inner = plist_node_retain(left -> right);
+        plist_node_release(left);
+        if (outer -> height >= inner -> height){
+            return plist_branch(outer, plist_branch(inner, right));
+        }
+        plist_node_t *inner_left = plist_node_retain(inner -> left);
+        plist_node_t *inner_right = plist_node_retain(inner -> right);
+        plist_node_release(inner);
+        return plist_branch(plist_branch(outer, inner_left), plist_branch(inner_right, right));
+    }
+    if (right -> height > left -> height + 1){
+        plist_node_t *outer = plist_node_retain(right -> right);
+        plist_node_t *inner = plist_node_retain(right -> left);
+        plist_node_release(right);
+        if (outer -> height >= inner -> height){
+            return plist_branch(plist_branch(left, inner), outer);
+        }
+        plist_node_t *inner_left = plist_node_retain(inner -> left);
+        plist_node_t *inner_right = plist_node_retain(inner -> right);
+        plist_node_release(inner);
+        return plist_branch(plist_branch(left, inner_left), plist_branch(inner_right, outer));
+    }
+    return plist_branch(left, right);
+}
+
+//Concatenates two trees, taking over the caller's references to both
+static plist_node_t *plist_join(plist_node_t *left, plist_node_t *right){
+    if (left == NULL || right == NULL){
+        return plist_branch(left, right);
+    }
+    if (left -> height == 0 && right -> height == 0 && left -> length + right -> length <= PLIST_CHUNK){
+        //two leaves that fit in one
+        plist_node_t *leaf = plist_node_alloc(left -> length + right -> length);
+        if (leaf != NULL){
+            for (size_t i = 0; i < left -> length; i++){
+                leaf -> items[i] = object_retain(left -> items[i]);
+            }
+            for (size_t i = 0; i < right -> length; i++){
+                leaf -> items[left -> length + i] = object_retain(right -> items[i]);
+            }
+            leaf -> length = left -> length + right -> length;
+        }
+        plist_node_release(left);
+        plist_node_release(right);
+        return leaf;
+    }
+    //go down the taller side until the heights match, a lone leaf goes all the way to meet the leaf on the other side
+    if (left -> height > right -> height + 1 || (right -> height == 0 && left -> height > 0)){
+        plist_node_t *outer = plist_node_retain(left -> left);
+        plist_node_t *joined = plist_join(plist_node_retain(left -> right), right);
+        plist_node_release(left);
+        return plist_balance(outer, joined);
+    }
+    if (right -> height > left -> height + 1 || (left -> height == 0 && right -> height > 0)){
+        plist_node_t *outer = plist_node_retain(right -> right);
+        plist_node_t *joined = plist_join(left, plist_node_retain(right -> left));
+        plist_node_release(right);
+        return plist_balance(joined, outer);
+    }
+    return plist_branch(left, right);
+}
+
+//Balanced tree over 'count' (at least one) items, retained
+static plist_node_t *plist_build(object_t **items, size_t count){
+    if (count <= PLIST_CHUNK){
+        return plist_leaf(items, count);
+    }
+    //half the leaves on either side, so the heights differ by one at most
+    size_t leaves = (count + PLIST_CHUNK - 1) / PLIST_CHUNK;
+    size_t split = leaves / 2 * PLIST_CHUNK;
+    plist_node_t *left = plist_build(items, split);
+    plist_node_t *right = left != NULL ? plist_build(items + split, count - split) : NULL;
+    return plist_branch(left, right);
+}
+
+//Copy of the path to item 'index' with 'item' (retained) stored there
+static plist_node_t *plist_node_set(plist_node_t *node, size_t index, object_t *item){
+    if (node -> height == 0){
+        plist_node_t *leaf = plist_leaf(node -> items, node -> length);
+        if (leaf != NULL){
+            object_free(leaf -> items[index]);
+            leaf -> items[index] = object_retain(item);
+        }
+        return leaf;
+    }
+    if (index < node -> left -> length){
+        plist_node_t *left = plist_node_set(node -> left, index, item);
+        return left != NULL ? plist_branch(left, plist_node_retain(node -> right)) : NULL;
+    }
+    plist_node_t *right = plist_node_set(node -> right, index - node -> left -> length, item);
+    return right != NULL ? plist_branch(plist_node_retain(node -> left), right) : NULL;
+}
+
+//Item 'index' of a PLIST, borrowed. The index must be in range.
+static object_t *plist_item(const object_t *list, size_t index){
+    const plist_node_t *node = list -> data.v_plist.root;
+    while (node -> height > 0){
+        if (index < node -> left -> length){
+            node = node -> left;
+        }
+        else {
+            index -= node -> left -> length;
+            node = node -> right;
+        }
+    }
+    return node -> items[index];
+}
+
+//New PLIST object over 'root', taking over the reference to it
+static object_t *plist_wrap(plist_node_t *root){
+    object_t *new_obj = object_new(OBJECT_SIZE_OF(v_plist), PLIST);
+    if (new_obj == NULL){
+        plist_node_release(root);
+        return NULL;
+    }
+    new_obj -> data.v_plist.length = root != NULL ? root -> length : 0;
+    new_obj -> data.v_plist.root = root;
+    return new_obj;
+}
+
+static bool plist_check(object_t *list){
+    if (list == NULL){
+        fprintf(stderr, "Cannot perform operation on null object\n");
+        return false;
+    }
+    if (object_kind(list) != PLIST){
+        fprintf(stderr, "Cannot perform operation on non_plist kind\n");
+        return false;
+    }
+    return true;
+}
+
+//Whether a version made right now may hold 'item', with an error if not
+static bool plist_can_hold(object_t *item){
+    if (mode_can_hold(object_alloc_flags(), item)){
+        return true;
+    }
+    fprintf(stderr, "Cannot store an arena or collected object in a plist outside of its arena or collector\n");
+    return false;
+}
+
+//plist_check, plus: a version made right now may share the list's nodes
+static bool plist_check_shareable(object_t *list){
+    if (!plist_check(list)){
+        return false;
+    }
+    if (!view_can_hold(list)){
+        fprintf(stderr, "Cannot build on an arena or collected plist outside of its arena or collector\n");
+        return false;
+    }
+    return true;
+}
+
+object_t *new_object_plist(void){
+    return plist_wrap(NULL);
+}
+
+//Persistent list with the collection's items (retained), O(n)
+object_t *plist_from_collection(object_t *collection){
+    if (collection == NULL || object_kind(collection) != COLLECTION){
+        fprintf(stderr, "Cannot perform operation on non_collection kind\n");
+        return NULL;
+    }
+    size_t length = collection -> data.v_collection.length;
+    if (length == 0){
+        return new_object_plist();
+    }
+    if (collection -> data.v_collection.items == ITEMS_BOXED){
+        plist_node_t *root = plist_build(collection -> data.v_collection.data, length);
+        return root != NULL ? plist_wrap(root) : NULL;
+    }
+    //packed values are rebuilt as immediates first
+    object_t **items = malloc(sizeof(object_t *) * length);
+    if (items == NULL){
+        return NULL;
+    }
+    for (size_t i = 0; i < length; i++){
+        items[i] = collection_item(collection, i);
+    }
+    plist_node_t *root = plist_build(items, length);
+    free(items);
+    return root != NULL ? plist_wrap(root) : NULL;
+}
+
+//Item 'index' (borrowed, like collection_access)
+object_t *plist_get(object_t *list, size_t index){
+    if (!plist_check(list)){
+        return NULL;
+    }
+    if (index >= list -> data.v_plist.length){
+        fprintf(stderr, "Index specified is out of bounds\n");
+        return NULL;
+    }
+    return plist_item(list, index);
+}
+
+//New version with 'item' after the last item, O(log n). Takes ownership of 'item' on success.
+object_t *plist_append(object_t *list, object_t *item){
+    if (!plist_check_shareable(list)){
+        return NULL;
+    }
+    if (item == NULL){
+        fprintf(stderr, "Cannot perform operation on null object\n");
+        return NULL;
+    }
+    if (!plist_can_hold(item)){
+        return NULL;
+    }
+    plist_node_t *leaf = plist_leaf(&item, 1);
+    if (leaf == NULL){
+        return NULL;
+    }
+    plist_node_t *root = list -> data.v_plist.root != NULL ? plist_join(plist_node_retain(list -> data.v_plist.root), leaf) : leaf;
+    object_t *version = root != NULL ? plist_wrap(root) : NULL;
+    if (version != NULL){
+        object_free(item); //the leaf holds it now
+    }
+    return version;
+}
+
+//New version with 'item' in place of item 'index', O(log n). Takes ownership of 'item' on success.
+object_t *plist_set(object_t *list, size_t index, object_t *item){
+    if (!plist_check_shareable(list)){
+        return NULL;
+    }
+    if (item == NULL){
+        fprintf(stderr, "Cannot perform operation on null object\n");
+        return NULL;
+    }
+    if (!plist_can_hold(item)){
+        return NULL;
+    }
+    if (index >= list -> data.v_plist.length){
+        fprintf(stderr, "Index specified is out of bounds\n");
+        return NULL;
+    }
+    plist_node_t *root = plist_node_set(list -> data.v_plist.root, index, item);
+    object_t *version = root != NULL ? plist_wrap(root) : NULL;
+    if (version != NULL){
+        object_free(item); //the new leaf holds it now
+    }
+    return version;
+}
+
+//New list with the items of 'a' followed by those of 'b', O(log n). Neither is consumed.
+object_t *plist_concat(object_t *a, object_t *b){
+    if (!plist_check_shareable(a) || !plist_check_shareable(b)){
+        return NULL;
+    }
+    //versions never change, an empty side means the other one is the answer
+    if (b -> data.v_plist.root == NULL){
+        return object_retain(a);
+    }
+    if (a -> data.v_plist.root == NULL){
+        return object_retain(b);
+    }
+    plist_node_t *root = plist_join(plist_node_retain(a -> data.v_plist.root), plist_node_retain(b -> data.v_plist.root));
+    return root != NULL ? plist_wrap(root) : NULL;
+}
+
+// ======= SORTING =======
+// object_compare is a total order over every kind: numbers first (INTEGER and
+// FLOAT compared by value, an INTEGER before an equal FLOAT, -0.0 before 0.0,
+// NaN last), then strings, collections, vectors, matrices, dicts, sets, deques
+// and persistent lists. Within a kind it is lexicographic: bytes for strings,
+// items for collections, deques and lists, coords for vectors.
+// It mostly returns 0 exactly when object_equals is true. The exceptions are
+// floats, where a total order has to part ways with ==: -0.0 and 0.0 are equal
+// but ordered, and a NaN compares equal to any NaN though it equals nothing.
+// Dicts and sets have no natural order and are only told apart by size and hash.
+//
+// collection_sort sorts in place, ascending. Collections of only INTEGERs or only
+// FLOATs (packed or boxed) are sorted by an LSD radix sort on extracted 32-bit
+// keys, everything else by an introsort on the item pointers: quicksort with a
+// median-of-three pivot, heapsort once the recursion gets too deep, insertion
+// sort for short runs. Neither is stable with respect to equal keys of different
+// kinds, which object_compare never reports as equal anyway.
+#define SORT_INSERTION_MAX 16
+#define SORT_RADIX_MIN 64
+
+static int kind_rank(object_kind_t kind){
+    switch (kind){
+        case INTEGER:
+        case FLOAT:
+            return 0;
+        case STRING:
+            return 1;
+        case COLLECTION:
+            return 2;
+        case VECTOR:
+            return 3;
+        case MATRIX:
+            return 4;
+        case DICT:
+            return 5;
+        case SET:
+            return 6;
+        case DEQUE:
+            return 7;
+        case PLIST:
+            return 8;
+        default:
+            return 9;
+    }
+}
+
+//Floats by value, -0.0 just before 0.0, NaN after everything else and equal to any other NaN
+static inline int float_compare(float a, float b){
+    if (a < b){
+        return -1;
+    }
+    if (a > b){
+        return 1;
+    }
+    if (a == b){
+        return (signbit(b) != 0) - (signbit(a) != 0);
+    }
+    return isnan(a) ? (isnan(b) ? 0 : 1) : -1;
+}
+
+static int floats_compare(const float *a, const float *b, size_t count){
+    for (size_t i = 0; i < count; i++){
+        int order = float_compare(a[i], b[i]);
+        if (order != 0){
+            return order;
+        }
+    }
+    //equal in order, object_equals compares bits though (NaN payloads)
+    int bytes = memcmp(a, b, sizeof(float) * count);
+    return (bytes > 0) - (bytes < 0);
+}
+
+static inline int size_compare(size_t a, size_t b){
+    return (a > b) - (a < b);
+}
+
+int object_compare(object_t *a, object_t *b){
+    if (a == NULL || b == NULL){
+        return (a != NULL) - (b != NULL);
+    }
+    object_kind_t kind_a = object_kind(a);
+    object_kind_t kind_b = object_kind(b);
+    int rank = kind_rank(kind_a) - kind_rank(kind_b);
+    if (rank != 0){
+        return rank < 0 ? -1 : 1;
+    }
+    switch (kind_a){
+        case INTEGER:
+        case FLOAT:{
+            if (kind_a == INTEGER && kind_b == INTEGER){
+                int x = object_int(a);
+                int y = object_int(b);
+                return (x > y) - (x < y);
+            }
+            if (kind_a == FLOAT && kind_b == FLOAT){
+                return float_compare(object_float(a), object_float(b));
+            }
+            //doubles hold every int and float exactly
+            double x = kind_a == INTEGER ? (double)object_int(a) : (double)object_float(a);
+            double y = kind_b == INTEGER ? (double)object_int(b) : (double)object_float(b);
+            if (x < y){
+                return -1;
+            }
+            if (x > y){
+                return 1;
+            }
+            if (isnan(x) != isnan(y)){
+                return isnan(x) ? 1 : -1;
+            }
+            return kind_a == kind_b ? 0 : (kind_a == INTEGER ? -1 : 1);
+        }
+        case STRING:{
+            if (a == b){
+                return 0;
+            }
+            if (string_flatten(a) == NULL || string_flatten(b) == NULL){
+                return 0;
+            }
+            size_t length_a = a -> data.v_string.length;
+            size_t length_b = b -> data.v_string.length;
+            int bytes = memcmp(a -> data.v_string.chars, b -> data.v_string.chars, length_a < length_b ? length_a : length_b);
+            return bytes != 0 ? (bytes > 0) - (bytes < 0) : size_compare(length_a, length_b);
+        }
+        case COLLECTION:{
+            size_t length_a = a -> data.v_collection.length;
+            size_t length_b = b -> data.v_collection.length;
+            for (size_t i = 0; i < length_a && i < length_b; i++){
+                int order = object_compare(collection_item(a, i), collection_item(b, i));
+                if (order != 0){
+                    return order;
+                }
+            }
+            return size_compare(length_a, length_b);
+        }
+        case VECTOR:{
+            size_t dims_a = a -> data.v_vector.dimensions;
+            size_t dims_b = b -> data.v_vector.dimensions;
+            int order = floats_compare(a -> data.v_vector.coords, b -> data.v_vector.coords, dims_a < dims_b ? dims_a : dims_b);
+            return order != 0 ? order : size_compare(dims_a, dims_b);
+        }
+        case MATRIX:{
+            int order = size_compare(a -> data.v_matrix.rows, b -> data.v_matrix.rows);
+            if (order == 0){
+                order = size_compare(a -> data.v_matrix.cols, b -> data.v_matrix.cols);
+            }
+            if (order == 0){
+                order = floats_compare(a -> data.v_matrix.values, b -> data.v_matrix.values, a -> data.v_matrix.rows * a -> data.v_matrix.cols);
+            }
+            return order;
+        }
+        case DEQUE:{
+            size_t length_a = a -> data.v_deque.length;
+            size_t length_b = b -> data.v_deque.length;
+            for (size_t i = 0; i < length_a && i < length_b; i++){
+                int order = object_compare(deque_item(a, i), deque_item(b, i));
+                if (order != 0){
+                    return order;
+                }
+            }
+            return size_compare(length_a, length_b);
+        }
+        case PLIST:{
+            size_t length_a = a -> data.v_plist.length;
+            size_t length_b = b -> data.v_plist.length;
+            for (size_t i = 0; i < length_a && i < length_b; i++){
+                int order = object_compare(plist_item(a, i), plist_item(b, i));
+                if (order != 0){
+                    return order;
+                }
+            }
+            return size_compare(length_a, length_b);
+        }
+        case DICT:
+        case SET:{
+            int order = size_compare(a -> data.v_dict.length, b -> data.v_dict.length);
+            if (order != 0 || object_equals(a, b)){
+                return order;
+            }
+            order = size_compare(object_hash(a), object_hash(b));
+            //unequal with equal hashes: any fixed order will do
+            return order != 0 ? order : size_compare((uintptr_t)a, (uintptr_t)b);
+        }
+        default:
+            return size_compare((uintptr_t)a, (uintptr_t)b);
+    }
+}
+
+static inline void sort_swap(object_t **items, size_t i, size_t j){
+    object_t *held = items[i];
+    items[i] = items[j];
+    items[j] = held;
+}
+
+static void insertion_sort(object_t **items, size_t count){
+    for (size_t i = 1; i < count; i++){
+        object_t *item = items[i];
+        size_t j = i;
+        while (j > 0 && object_compare(items[j - 1], item) > 0){
+            items[j] = items[j - 1];
+            j--;
+        }
+        items[j] = item;
+    }
+}
+
+static void heap_sift_down(object_t **items, size_t root, size_t count){
+    while (2 * root + 1 < count){
+        size_t child = 2 * root + 1;
+        if (child + 1 < count && object_compare(items[child], items[child + 1]) < 0){
+            child++;
+        }
+        if (object_compare(items[root], items[child]) >= 0){
+            return;
+        }
+        sort_swap(items, root, child);
+        root = child;
+    }
+}
+
+static void heap_sort(object_t **items, size_t count){
+    for (size_t i = count / 2; i-- > 0;){
+        heap_sift_down(items, i, count);
+    }
+    for (size_t end = count; end-- > 1;){
+        sort_swap(items, 0, end);
+        heap_sift_down(items, 0, end);
+    }
+}
+
+static void intro_sort(object_t **items, size_t count, size_t depth){
+    while (count > SORT_INSERTION_MAX){
+        if (depth == 0){
+            heap_sort(items, count);
+            return;
+        }
+        depth--;
+        //median of three to the front, it is the pivot
+        size_t mid = count / 2;
+        if (object_compare(items[mid], items[0]) < 0){
+            sort_swap(items, mid, 0);
+        }
+        if (object_compare(items[count - 1], items[0]) < 0){
+            sort_swap(items, count - 1, 0);
+        }
+        if (object_compare(items[count - 1], items[mid]) < 0){
+            sort_swap(items, count - 1, mid);
+        }
+        sort_swap(items, 0, mid);
+        object_t *pivot = items[0];
+
+        //Hoare partition around the pivot
+        size_t i = 0;
+        size_t j = count;
+        while (true){
+            do {
+                i++;
+            } while (i < count && object_compare(items[i], pivot) < 0);
+            do {
+                j--;
+            } while (object_compare(items[j], pivot) > 0);
+            if (i >= j){
+                break;
+            }
+            sort_swap(items, i, j);
+        }
+        sort_swap(items, 0, j);
+
+        //recurse into the smaller side, loop on the larger one
+        if (j < count - j - 1){
+            intro_sort(items, j, depth);
+            items += j + 1;
+            count -= j + 1;
+        }
+        else {
+            intro_sort(items + j + 1, count - j - 1, depth);
+            count = j;
+        }
+    }
+    insertion_sort(items, count);
+}
+
+//Sorts pointers with object_compare, O(n log n) worst case
+static void object_sort(object_t **items, size_t count){
+    size_t depth = 0;
+    for (size_t n = count; n > 1; n >>= 1){
+        depth += 2;
+    }
+    intro_sort(items, count, depth);
+}
+
+//Order-preserving unsigned keys for ints and (non NaN) floats, in float_compare's
+//order: -0.0 gets the key just below 0.0, so the value survives the round trip
+static inline uint32_t int_sort_key(int32_t value){
+    return (uint32_t)value ^ 0x80000000u;
+}
+
+static inline uint32_t float_sort_key(float value){
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+//LSD radix sort of 32-bit keys, a byte per pass. Passes where every key has the same byte are skipped.
+static void radix_sort_u32(uint32_t *keys, uint32_t *scratch, size_t count){
+    if (count == 0){
+        return;
+    }
+    size_t histogram[4][256] = {{0}};
+    for (size_t i = 0; i < count; i++){
+        for (int b = 0; b < 4; b++){
+            histogram[b][(keys[i] >> (8 * b)) & 0xff]++;
+        }
+    }
+    uint32_t *from = keys;
+    uint32_t *to = scratch;
+    for (int b = 0; b < 4; b++){
+        if (histogram[b][(from[0] >> (8 * b)) & 0xff] == count){
+            continue;
+        }
+        size_t offset = 0;
+        for (int v = 0; v < 256; v++){
+            size_t bucket = histogram[b][v];
+            histogram[b][v] = offset;
+            offset += bucket;
+        }
+        for (size_t i = 0; i < count; i++){
+            to[histogram[b][(from[i] >> (8 * b)) & 0xff]++] = from[i];
+        }
+        uint32_t *swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != keys){
+        memcpy(keys, from, sizeof(uint32_t) * count);
+    }
+}
+
+//Same, for 64-bit entries sorted by their high 32 bits only (a key above an index)
+static void radix_sort_keyed(uint64_t *entries, uint64_t *scratch, size_t count){
+    if (count == 0){
+        return;
+    }
+    size_t histogram[4][256] = {{0}};
+    for (size_t i = 0; i < count; i++){
+        for (int b = 0; b < 4; b++){
+            histogram[b][(entries[i] >> (32 + 8 * b)) & 0xff]++;
+        }
+    }
+    uint64_t *from = entries;
+    uint64_t *to = scratch;
+    for (int b = 0; b < 4; b++){
+        if (histogram[b][(from[0] >> (32 + 8 * b)) & 0xff] == count){
+            continue;
+        }
+        size_t offset = 0;
+        for (int v = 0; v < 256; v++){
+            size_t bucket = histogram[b][v];
+            histogram[b][v] = offset;
+            offset += bucket;
+        }
+        for (size_t i = 0; i < count; i++){
+            to[histogram[b][(from[i] >> (32 + 8 * b)) & 0xff]++] = from[i];
+        }
+        uint64_t *swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != entries){
+        memcpy(entries, from, sizeof(uint64_t) * count);
+    }
+}
+
+static inline float float_from_sort_key(uint32_t key){
+    uint32_t bits = (key & 0x80000000u) ? key & 0x7fffffffu : ~key;
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+//Radix path for packed storage: the values themselves are sorted
+static int collection_sort_packed(object_t *collection){
+    size_t count = collection -> data.v_collection.length;
+    bool ints = collection -> data.v_collection.items == ITEMS_INT;
+    uint32_t *keys = (uint32_t *)(void *)collection -> data.v_collection.data;
+    uint32_t *scratch = malloc(sizeof(uint32_t) * count);
+    if (scratch == NULL){
+        return -1;
+    }
+    size_t nans = 0;
+    if (ints){
+        for (size_t i = 0; i < count; i++){
+            keys[i] = int_sort_key((int32_t)keys[i]);
+        }
+    }
+    else {
+        //NaNs have no place in the key order, they are parked in the scratch
+        //buffer and go to the end in their original order, bits untouched
+        float *values = collection_floats(collection);
+        size_t kept = 0;
+        for (size_t i = 0; i < count; i++){
+            if (isnan(values[i])){
+                memcpy(&scratch[nans++], &values[i], sizeof(uint32_t));
+                continue;
+            }
+            keys[kept++] = float_sort_key(values[i]);
+        }
+        memcpy(keys + kept, scratch, sizeof(uint32_t) * nans);
+    }
+    size_t sorted = count - nans;
+    radix_sort_u32(keys, scratch, sorted);
+    free(scratch);
+    for (size_t i = 0; i < sorted; i++){
+        if (ints){
+            keys[i] ^= 0x80000000u;
+        }
+        else {
+            collection_floats(collection)[i] = float_from_sort_key(keys[i]);
+        }
+    }
+    return 0;
+}
+
+//Radix path for boxed items that are all INTEGER or all FLOAT: sort (key, index) pairs, then permute the pointers
+static int collection_sort_boxed_numbers(object_t *collection, object_kind_t kind){
+    size_t count = collection -> data.v_collection.length;
+    object_t **items = collection -> data.v_collection.data;
+    uint64_t *entries = malloc(sizeof(uint64_t) * count * 2);
+    object_t **sorted = malloc(sizeof(object_t *) * count);
+    if (entries == NULL || sorted == NULL){
+        free(entries);
+        free(sorted);
+        return -1;
+    }
+    size_t kept = 0;
+    size_t nans = 0;
+    for (size_t i = 0; i < count; i++){
+        uint32_t key;
+        if (kind == INTEGER){
+            key = int_sort_key(object_int(items[i]));
+        }
+        else if (isnan(object_float(items[i]))){
+            //NaNs keep their relative order at the end
+            sorted[count - 1 - nans++] = items[i];
+            continue;
+        }
+        else {
+            key = float_sort_key(object_float(items[i]));
+        }
+        entries[kept++] = (uint64_t)key << 32 | i;
+    }
+    radix_sort_keyed(entries, entries + count, kept);
+    for (size_t i = 0; i < kept; i++){
+        sorted[i] = items[(uint32_t)entries[i]];
+    }
+    //the NaNs went in back to front
+    for (size_t i = 0; i < nans / 2; i++){
+        sort_swap(sorted, kept + i, count - 1 - i);
+    }
+    memcpy(items, sorted, sizeof(object_t *) * count);
+    free(sorted);
+    free(entries);
+    return 0;
+}
+
+//Insertion sort straight on packed values, for runs too short to pay for the radix passes
+static void collection_sort_packed_short(object_t *collection){
+    size_t count = collection -> data.v_collection.length;
+    if (collection -> data.v_collection.items == ITEMS_INT){
+        int32_t *values = collection_ints(collection);
+        for (size_t i = 1; i < count; i++){
+            int32_t value = values[i];
+            size_t j = i;
+            while (j > 0 && values[j - 1] > value){
+                values[j] = values[j - 1];
+                j--;
+            }
+            values[j] = value;
+        }
+        return;
+    }
+    float *values = collection_floats(collection);
+    for (size_t i = 1; i < count; i++){
+        float value = values[i];
+        size_t j = i;
+        while (j > 0 && float_compare(values[j - 1], value) > 0){
+            values[j] = values[j - 1];
+            j--;
+        }
+        values[j] = value;
+    }
+}
+
+int collection_sort(object_t *collection){
+    if (collection == NULL){
+        fprintf(stderr, "Cannot perform operation on null object\n");
+        return -1;
+    }
+    if (object_kind(collection) != COLLECTION){
+        fprintf(stderr, "Cannot perform sort on non_collection kind\n");
+        return -1;
+    }
+    size_t count = collection -> data.v_collection.length;
+    if (count < 2){
+        return 0;
+    }
+    if (collection_make_unique(collection) != 0){
+        return -1;
+    }
+    if (collection -> data.v_collection.items != ITEMS_BOXED){
+        if (count >= SORT_RADIX_MIN){
+            return collection_sort_packed(collection);
+        }
+        collection_sort_packed_short(collection);
+        return 0;
+    }
+    object_kind_t kind = object_kind(collection_item(collection, 0));
+    bool numbers = (kind == INTEGER || kind == FLOAT) && count <= UINT32_MAX;
+    for (size_t i = 1; numbers && i < count; i++){
+        numbers = object_kind(collection_item(collection, i)) == kind;
+    }
+    if (count >= SORT_RADIX_MIN && numbers){
+        return collection_sort_boxed_numbers(collection, kind);
+    }
+    object_sort(collection -> data.v_collection.data, count);
+    return 0;
+}
+
+//Releases everything the object owns apart from its own block
+static void object_release_payload(object_t *obj){
+    if (view_base(obj) != NULL){
+        //the payload is the base's
+        object_free(view_base(obj));
+        return;
+    }
+    switch (object_kind(obj)){
+        case STRING:
+            rope_release(obj -> data.v_string.rope);
+            if (!string_is_inline(obj)){
+                free(obj -> data.v_string.chars);
+            }
+            break;
+        case COLLECTION:
+            collection_store_release(obj -> data.v_collection.data, obj -> data.v_collection.length, obj -> data.v_collection.items);
+            break;
+        case VECTOR:
+            if (!vector_is_inline(obj)){
+                float_buffer_free(obj -> data.v_vector.coords);
+            }
+            break;
+        case MATRIX:
+            float_buffer_free(obj -> data.v_matrix.values);
+            break;
+        case VECTOR_EXPR:
+            object_free(obj -> data.v_expr.left);
+            object_free(obj -> data.v_expr.right);
+            break;
+        case DICT:
+        case SET:
+            for (size_t i = 0; i < obj -> data.v_dict.capacity; i++){
+                if (obj -> data.v_dict.slots[i].key != NULL){
+                    object_free(obj -> data.v_dict.slots[i].key);
+                    object_free(obj -> data.v_dict.slots[i].value);
+                }
+            }
+            dict_slots_free(obj, obj -> data.v_dict.slots);
+            break;
+        case DEQUE:
+            for (size_t i = 0; i < obj -> data.v_deque.length; i++){
+                object_free(deque_item(obj, i));
+            }
+            deque_items_free(obj, obj -> data.v_deque.items);
+            break;
+        case PLIST:
+            plist_node_release(obj -> data.v_plist.root);
+            break;
+        default:
+            break;
+    }
+}
+
+//Size of the object's own block, as passed to object_alloc
+static size_t object_size(const object_t *obj){
+    switch (object_kind(obj)){
+        case STRING:
+            return string_object_size(obj);
+        case VECTOR:
+            return vector_object_size(obj);
+        case INTEGER:
+            return OBJECT_SIZE_OF(v_int);
+        case FLOAT:
+            return OBJECT_SIZE_OF(v_float);
+        case COLLECTION:
+            return OBJECT_SIZE_OF(v_collection) + (obj -> flags & OBJ_FLAG_VIEW ? sizeof(object_t *) : 0);
+        case MATRIX:
+            return OBJECT_SIZE_OF(v_matrix);
+        case VECTOR_EXPR:
+            return OBJECT_SIZE_OF(v_expr);
+        case DICT:
+        case SET:
+            return OBJECT_SIZE_OF(v_dict);
+        case DEQUE:
+            return OBJECT_SIZE_OF(v_deque);
+        case PLIST:
+            return OBJECT_SIZE_OF(v_plist);
+        default:
+            return sizeof(object_t);
+    }
+}
+
+void object_free(object_t *obj){
+    if (obj == NULL || object_is_immediate(obj) || (obj -> flags & (OBJ_FLAG_ARENA | OBJ_FLAG_GC | OBJ_FLAG_INTERNED))){
+        return;
+    }
+    if (REFCOUNT_DECREMENT(obj -> refcount) > 0){
+        return;
+    }
+    object_release_payload(obj);
+    object_dealloc(obj, object_size(obj));
+}
+
+static DYNC_THREAD_LOCAL vm_t **gc_vm_roots = NULL;
+static DYNC_THREAD_LOCAL size_t gc_vm_root_count = 0;
+static DYNC_THREAD_LOCAL size_t gc_vm_root_capacity = 0;
+static DYNC_THREAD_LOCAL object_t ***gc_slot_roots = NULL;
+static DYNC_THREAD_LOCAL size_t gc_slot_root_count = 0;
+static DYNC_THREAD_LOCAL size_t gc_slot_root_capacity = 0;
+static DYNC_THREAD_LOCAL object_t **gc_mark_stack = NULL;
+static DYNC_THREAD_LOCAL size_t gc_mark_capacity = 0;
+
+static bool gc_root_reserve(void **roots, size_t *capacity, size_t count){
+    if (count < *capacity){
+        return true;
+    }
+    size_t new_cap = *capacity == 0 ? 8 : *capacity * 2;
+    void *grown = realloc(*roots, sizeof(void *) * new_cap);
+    if (grown == NULL){
+        return false;
+    }
+    *roots = grown;
+    *capacity = new_cap;
+    return true;
+}
+
+//Keeps whatever *slot points to at collection time alive, until gc_remove_root(slot)
+bool gc_add_root(object_t **slot){
+    if (slot == NULL || !gc_root_reserve((void **)&gc_slot_roots, &gc_slot_root_capacity, gc_slot_root_count)){
+        return false;
+    }
+    gc_slot_roots[gc_slot_root_count++] = slot;
+    return true;
+}
+
+void gc_remove_root(object_t **slot){
+    for (size_t i = 0; i < gc_slot_root_count; i++){
+        if (gc_slot_roots[i] == slot){
+            gc_slot_roots[i] = gc_slot_roots[--gc_slot_root_count];
+            return;
+        }
+    }
+}
+
+static bool gc_register_vm(vm_t *vm){
+    for (size_t i = 0; i < gc_vm_root_count; i++){
+        if (gc_vm_roots[i] == vm){
+            return true;
+        }
+    }
+    if (!gc_root_reserve((void **)&gc_vm_roots, &gc_vm_root_capacity, gc_vm_root_count)){
+        return false;
+    }
+    gc_vm_roots[gc_vm_root_count++] = vm;
+    return true;
+}
+
+static void gc_unregister_vm(vm_t *vm){
+    for (size_t i = 0; i < gc_vm_root_count; i++){
+        if (gc_vm_roots[i] == vm){
+            gc_vm_roots[i] = gc_vm_roots[--gc_vm_root_count];
+            return;
+        }
+    }
+}
+
+//Marks 'obj' and queues it for tracing. False if the mark stack cannot grow.
+static bool gc_mark_push(object_t *obj, size_t *depth){
+    if (obj == NULL || object_is_immediate(obj) || !(obj -> flags & OBJ_FLAG_GC) || (obj -> flags & OBJ_FLAG_MARKED)){
+        return true;
+    }
+    if (!gc_root_reserve((void **)&gc_mark_stack, &gc_mark_capacity, *depth)){
+        return false;
+    }
+    obj -> flags |= OBJ_FLAG_MARKED;
+    gc_mark_stack[(*depth)++] = obj;
+    return true;
+}
+
+//Marks the items under a PLIST node. Nodes are shared between versions, so a
+//node reachable from several lists is walked once per list.
+static bool gc_mark_plist(const plist_node_t *node, size_t *depth){
+    while (node != NULL && node -> height > 0){
+        if (!gc_mark_plist(node -> left, depth)){
+            return false;
+        }
+        node = node -> right;
+    }
+    for (size_t i = 0; node != NULL && i < node -> length; i++){
+        if (!gc_mark_push(node -> items[i], depth)){
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool gc_mark_roots(void){
+    size_t depth = 0;
+    bool ok = true;
+    for (size_t i = 0; ok && i < gc_vm_root_count; i++){
+        for (size_t j = 0; ok && j < gc_vm_roots[i] -> sp; j++){
+            ok = gc_mark_push(gc_vm_roots[i] -> stack[j], &depth);
+        }
+    }
+    for (size_t i = 0; ok && i < gc_slot_root_count; i++){
+        ok = gc_mark_push(*gc_slot_roots[i], &depth);
+    }
+    //an explicit stack, nesting depth is up to the program
+    while (ok && depth > 0){
+        object_t *obj = gc_mark_stack[--depth];
+        if (view_base(obj) != NULL){
+            ok = gc_mark_push(view_base(obj), &depth);
+        }
+        else if (object_kind(obj) == COLLECTION && obj -> data.v_collection.items == ITEMS_BOXED){
+            for (size_t i = 0; ok && i < obj -> data.v_collection.length; i++){
+                ok = gc_mark_push(obj -> data.v_collection.data[i], &depth);
+            }
+        }
+        else if (object_kind(obj) == VECTOR_EXPR){
+            ok = gc_mark_push(obj -> data.v_expr.left, &depth) && gc_mark_push(obj -> data.v_expr.right, &depth);
+        }
+        else if (object_kind(obj) == DICT || object_kind(obj) == SET){
+            for (size_t i = 0; ok && i < obj -> data.v_dict.capacity; i++){
+                dict_slot_t *slot = &obj -> data.v_dict.slots[i];
+                if (slot -> key != NULL){
+                    ok = gc_mark_push(slot -> key, &depth) && gc_mark_push(slot -> value, &depth);
+                }
+            }
+        }
+        else if (object_kind(obj) == DEQUE){
+            for (size_t i = 0; ok && i < obj -> data.v_deque.length; i++){
+                ok = gc_mark_push(deque_item(obj, i), &depth);
+            }
+        }
+        else if (object_kind(obj) == PLIST){
+            ok = gc_mark_plist(obj -> data.v_plist.root, &depth);
+        }
+    }
+    return ok;
+}
+
+//Frees every collected object no root can reach. Returns how many were freed.
+size_t gc_collect(void){
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    bool marked = gc_mark_roots();
+    gc_link_t *dead = NULL;
+    size_t freed = 0;
+    size_t live = 0;
+    gc_link_t *link = gc_objects;
+    while (link != NULL){
+        gc_link_t *next = link -> next;
+        object_t *obj = (object_t *)(link + 1);
+        if (!marked || (obj -> flags & OBJ_FLAG_MARKED)){
+            //an incomplete mark keeps everything alive
+            obj -> flags &= ~OBJ_FLAG_MARKED;
+            live++;
+        }
+        else {
+            if (link -> prev != NULL){
+                link -> prev -> next = next;
+            }
+            else {
+                gc_objects = next;
+            }
+            if (next != NULL){
+                next -> prev = link -> prev;
+            }
+            link -> next = dead;
+            dead = link;
+        }
+        link = next;
+    }
+    //payloads first: releasing a collection still reads its (dead) items' headers
+    for (link = dead; link != NULL; link = link -> next){
+        object_release_payload((object_t *)(link + 1));
+    }
+    while (dead != NULL){
+        gc_link_t *next = dead -> next;
+        slab_dealloc(dead, sizeof(gc_link_t) + object_size((object_t *)(dead + 1)), ((object_t *)(dead + 1)) -> flags);
+        dead = next;
+        freed++;
+    }
+
+    gc_allocated = 0;
+    gc_pending = false;
+    gc_threshold = live * 2 > GC_INITIAL_THRESHOLD ? live * 2 : GC_INITIAL_THRESHOLD;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    uint64_t pause = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ULL + (uint64_t)(end.tv_nsec - start.tv_nsec);
+    size_t bucket = 0;
+    while (bucket < GC_PAUSE_BUCKETS - 1 && (pause / 1000) >> bucket != 0){
+        bucket++;
+    }
+    gc_statistics.collections++;
+    gc_statistics.objects_freed += freed;
+    gc_statistics.live_objects = live;
+    gc_statistics.total_pause_ns += pause;
+    gc_statistics.max_pause_ns = pause > gc_statistics.max_pause_ns ? pause : gc_statistics.max_pause_ns;
+    gc_statistics.pause_histogram[bucket]++;
+    return freed;
+}
+
+gc_stats_t gc_stats(void){
+    return gc_statistics;
+}
+
+void gc_reset_stats(void){
+    memset(&gc_statistics, 0, sizeof(gc_statistics));
+}
+
+void print_gc_stats(void){
+    printf("Collections: %zu\n", gc_statistics.collections);
+    printf("Objects freed: %zu\n", gc_statistics.objects_freed);
+    printf("Live after last collection: %zu\n", gc_statistics.live_objects);
+    printf("Total pause: %.3f ms\n", gc_statistics.total_pause_ns / 1e6);
+    printf("Max pause: %.3f ms\n", gc_statistics.max_pause_ns / 1e6);
+    printf("Pause histogram:\n");
+    for (size_t i = 0; i < GC_PAUSE_BUCKETS; i++){
+        if (gc_statistics.pause_histogram[i] == 0){
+            continue;
+        }
+        if (i == GC_PAUSE_BUCKETS - 1){
+            printf("  >= %6zu us: %zu\n", (size_t)1 << (i - 1), gc_statistics.pause_histogram[i]);
+        }
+        else {
+            printf("  <  %6zu us: %zu\n", (size_t)1 << i, gc_statistics.pause_histogram[i]);
+        }
+    }
+}
+
+
+
+
+typedef enum {
+    ARITH_ADD,
+    ARITH_SUB,
+    ARITH_MUL,
+    ARITH_DIV,
+} arith_op_t;
+
+// ======= VECTOR KERNELS =======
+// Element-wise vector-vector and vector-scalar kernels. Each instruction set gets
+// its own copy of the loops (compiled with a target attribute, so the file still
+// builds without -mavx2) and the best one the CPU supports is picked on first use.
+// Element-wise + - * / are exact in IEEE arithmetic, so every variant produces
+// bit-identical results to the scalar loops.
+typedef void (*vector_vv_kernel_t)(float *out, const float *a, const float *b, size_t n);
+typedef void (*vector_vs_kernel_t)(float *out, const float *a, float scalar, size_t n);
+
+typedef float (*vector_dot_kernel_t)(const float *a, const float *b, size_t n);
+typedef float (*vector_reduce_kernel_t)(const float *a, size_t n);
+typedef void (*vector_axpy_kernel_t)(float *out, float alpha, const float *x, const float *y, size_t n);
+
+typedef struct {
+    const char *name;
+    vector_vv_kernel_t vv[4]; //indexed by arith_op_t
+    vector_vs_kernel_t vs[4];
+    vector_dot_kernel_t dot;
+    vector_reduce_kernel_t sum;
+    vector_reduce_kernel_t min; //n must be > 0
+    vector_reduce_kernel_t max; //n must be > 0
+    vector_axpy_kernel_t axpy;
+} vector_kernels_t;
+
+#define DEFINE_SCALAR_KERNEL(name, op) \
+    static void vv_##name##_scalar(float *out, const float *a, const float *b, size_t n){ \
+        for (size_t i = 0; i < n; i++){ \
+            out[i] = a[i] op b[i]; \
+        } \
+    } \
+    static void vs_##name##_scalar(float *out, const float *a, float scalar, size_t n){ \
+        for (size_t i = 0; i < n; i++){ \
+            out[i] = a[i] op scalar; \
+        } \
+    }
+
+DEFINE_SCALAR_KERNEL(add, +)
+DEFINE_SCALAR_KERNEL(sub, -)
+DEFINE_SCALAR_KERNEL(mul, *)
+DEFINE_SCALAR_KERNEL(div, /)
+
+static float dot_scalar(const float *a, const float *b, size_t n){
+    float total = 0.0f;
+    for (size_t i = 0; i < n; i++){
+        total += a[i] * b[i];
+    }
+    return total;
+}
+
+static float sum_scalar(const float *a, size_t n){
+    float total = 0.0f;
+    for (size_t i = 0; i < n; i++){
+        total += a[i];
+    }
+    return total;
+}
+
+//min and max return NaN if any coord is NaN, in every kernel set
+static float min_scalar(const float *a, size_t n){
+    float best = a[0];
+    for (size_t i = 0; i < n; i++){
+        if (isnan(a[i])){
+            return a[i];
+        }
+        best = a[i] < best ? a[i] : best;
+    }
+    return best;
+}
+
+static float max_scalar(const float *a, size_t n){
+    float best = a[0];
+    for (size_t i = 0; i < n; i++){
+        if (isnan(a[i])){
+            return a[i];
+        }
+        best = a[i] > best ? a[i] : best;
+    }
+    return best;
+}
+
+static void axpy_scalar(float *out, float alpha, const float *x, const float *y, size_t n){
+    for (size_t i = 0; i < n; i++){
+        out[i] = alpha * x[i] + y[i];
+    }
+}
+
+static const vector_kernels_t scalar_kernels = {
+    "scalar",
+    {vv_add_scalar, vv_sub_scalar, vv_mul_scalar, vv_div_scalar},
+    {vs_add_scalar, vs_sub_scalar, vs_mul_scalar, vs_div_scalar},
+    dot_scalar, sum_scalar, min_scalar, max_scalar, axpy_scalar,
+};
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(DYNC_NO_SIMD)
+#include <immintrin.h>
+#define DYNC_X86_SIMD 1
+
+#define DEFINE_SIMD_KERNEL(isa, isa_target, width, vtype, loadu, storeu, set1, vop, name, op) \
+    __attribute__((target(isa_target))) \
+    static void vv_##name##_##isa(float *out, const float *a, const float *b, size_t n){ \
+        size_t i = 0; \
+        for (; i + width <= n; i += width){ \
+            storeu(out + i, vop(loadu(a + i), loadu(b + i))); \
+        } \
+        for (; i < n; i++){ \
+            out[i] = a[i] op b[i]; \
+        } \
+    } \
+    __attribute__((target(isa_target))) \
+    static void vs_##name##_##isa(float *out, const float *a, float scalar, size_t n){ \
+        vtype s = set1(scalar); \
+        size_t i = 0; \
+        for (; i + width <= n; i += width){ \
+            storeu(out + i, vop(loadu(a + i), s)); \
+        } \
+        for (; i < n; i++){ \
+            out[i] = a[i] op scalar; \
+        } \
+    }
+
+//Reductions keep one accumulator per lane and fold the lanes at the end, so
+//dot and sum round differently from the sequential scalar loop. The min/max
+//instructions return one operand or the other when either is NaN, so min and
+//max also collect an unordered compare of every load (nan_mark) and check it once.
+#define DEFINE_SIMD_REDUCTIONS(isa, isa_target, width, vtype, loadu, storeu, set1, prefix, nan_type, nan_none, nan_mark, nan_any) \
+    __attribute__((target(isa_target))) \
+    static float dot_##isa(const float *a, const float *b, size_t n){ \
+        vtype acc = set1(0.0f); \
+        size_t i = 0; \
+        for (; i + width <= n; i += width){ \
+            acc = prefix##_add_ps(acc, prefix##_mul_ps(loadu(a + i), loadu(b + i))); \
+        } \
+        float lanes[width]; \
+        storeu(lanes, acc); \
+        float total = 0.0f; \
+        for (size_t k = 0; k < width; k++){ \
+            total += lanes[k]; \
+        } \
+        for (; i < n; i++){ \
+            total += a[i] * b[i]; \
+        } \
+        return total; \
+    } \
+    __attribute__((target(isa_target))) \
+    static float sum_##isa(const float *a, size_t n){ \
+        vtype acc = set1(0.0f); \
+        size_t i = 0; \
+        for (; i + width <= n; i += width){ \
+            acc = prefix##_add_ps(acc, loadu(a + i)); \
+        } \
+        float lanes[width]; \
+        storeu(lanes, acc); \
+        float total = 0.0f; \
+        for (size_t k = 0; k < width; k++){ \
+            total += lanes[k]; \
+        } \
+        for (; i < n; i++){ \
+            total += a[i]; \
+        } \
+        return total; \
+    } \
+    __attribute__((target(isa_target))) \
+    static float min_##isa(const float *a, size_t n){ \
+        if (n < width){ \
+            return min_scalar(a, n); \
+        } \
+        vtype acc = loadu(a); \
+        nan_type nans = nan_mark(nan_none, acc); \
+        size_t i = width; \
+        for (; i + width <= n; i += width){ \
+            vtype x = loadu(a + i); \
+            nans = nan_mark(nans, x); \
+            acc = prefix##_min_ps(acc, x); \
+        } \
+        if (nan_any(nans)){ \
+            return NAN; \
+        } \
+        float lanes[width]; \
+        storeu(lanes, acc); \
+        float best = min_scalar(lanes, width); \
+        if (i < n){ \
+            float tail = min_scalar(a + i, n - i); \
+            best = isnan(tail) || tail < best ? tail : best; \
+        } \
+        return best; \
+    } \
+    __attribute__((target(isa_target))) \
+    static float max_##isa(const float *a, size_t n){ \
+        if (n < width){ \
+            return max_scalar(a, n); \
+        } \
+        vtype acc = loadu(a); \
+        nan_type nans = nan_mark(nan_none, acc); \
+        size_t i = width; \
+        for (; i + width <= n; i += width){ \
+            vtype x = loadu(a + i); \
+            nans = nan_mark(nans, x); \
+            acc = prefix##_max_ps(acc, x); \
+        } \
+        if (nan_any(nans)){ \
+            return NAN; \
+        } \
+        float lanes[width]; \
+        storeu(lanes, acc); \
+        float best = max_scalar(lanes, width); \
+        if (i < n){ \
+            float tail = max_scalar(a + i, n - i); \
+            best = isnan(tail) || tail > best ? tail : best; \
+        } \
+        return best; \
+    } \
+    __attribute__((target(isa_target))) \
+    static void axpy_##isa(float *out, float alpha, const float *x, const float *y, size_t n){ \
+        vtype va = set1(alpha); \
+        size_t i = 0; \
+        for (; i + width <= n; i += width){ \
+            storeu(out + i, prefix##_add_ps(prefix##_mul_ps(va, loadu(x + i)), loadu(y + i))); \
+        } \
+        for (; i < n; i++){ \
+            out[i] = alpha * x[i] + y[i]; \
+        } \
+    }
+
+#define DEFINE_SIMD_KERNELS(isa, isa_target, width, vtype, loadu, storeu, set1, prefix, nan_type, nan_none, nan_mark, nan_any) \
+    DEFINE_SIMD_REDUCTIONS(isa, isa_target, width, vtype, loadu, storeu, set1, prefix, nan_type, nan_none, nan_mark, nan_any) \
+    DEFINE_SIMD_KERNEL(isa, isa_target, width, vtype, loadu, storeu, set1, prefix##_add_ps, add, +) \
+    DEFINE_SIMD_KERNEL(isa, isa_target, width, vtype, loadu, storeu, set1, prefix##_sub_ps, sub, -) \
+    DEFINE_SIMD_KERNEL(isa, isa_target, width, vtype, loadu, storeu, set1, prefix##_mul_ps, mul, *) \
+    DEFINE_SIMD_KERNEL(isa, isa_target, width, vtype, loadu, storeu, set1, prefix##_div_ps, div, /) \
+    static const vector_kernels_t isa##_kernels = { \
+        #isa, \
+        {vv_add_##isa, vv_sub_##isa, vv_mul_##isa, vv_div_##isa}, \
+        {vs_add_##isa, vs_sub_##isa, vs_mul_##isa, vs_div_##isa}, \
+        dot_##isa, sum_##isa, min_##isa, max_##isa, axpy_##isa, \
+    };
+
+#define SSE_NAN_MARK(nans, x) _mm_or_ps((nans), _mm_cmpunord_ps((x), (x)))
+#define SSE_NAN_ANY(nans) (_mm_movemask_ps(nans) != 0)
+#define AVX2_NAN_MARK(nans, x) _mm256_or_ps((nans), _mm256_cmp_ps((x), (x), _CMP_UNORD_Q))
+#define AVX2_NAN_ANY(nans) (_mm256_movemask_ps(nans) != 0)
+#define AVX512_NAN_MARK(nans, x) ((__mmask16)((nans) | _mm512_cmp_ps_mask((x), (x), _CMP_UNORD_Q)))
+#define AVX512_NAN_ANY(nans) ((nans) != 0)
+
+DEFINE_SIMD_KERNELS(sse, "sse2", 4, __m128, _mm_loadu_ps, _mm_storeu_ps, _mm_set1_ps, _mm,
+                    __m128, _mm_setzero_ps(), SSE_NAN_MARK, SSE_NAN_ANY)
+DEFINE_SIMD_KERNELS(avx2, "avx2", 8, __m256, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_set1_ps, _mm256,
+                    __m256, _mm256_setzero_ps(), AVX2_NAN_MARK, AVX2_NAN_ANY)
+DEFINE_SIMD_KERNELS(avx512, "avx512f", 16, __m512, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_set1_ps, _mm512,
+                    __mmask16, 0, AVX512_NAN_MARK, AVX512_NAN_ANY)
+#endif
+
+//Resolved on first use, per thread like the rest of the runtime state. Reduction
+//worker threads do not resolve their own, they get the caller's in their task.
+static DYNC_THREAD_LOCAL const vector_kernels_t *active_kernels = NULL;
+
+static const vector_kernels_t *vector_kernels(void){
+    if (active_kernels != NULL){
+        return active_kernels;
+    }
+    active_kernels = &scalar_kernels;
+#ifdef DYNC_X86_SIMD
+    if (__builtin_cpu_supports("avx512f")){
+        active_kernels = &avx512_kernels;
+    }
+    else if (__builtin_cpu_supports("avx2")){
+        active_kernels = &avx2_kernels;
+    }
+    else if (__builtin_cpu_supports("sse2")){
+        active_kernels = &sse_kernels;
+    }
+#endif
+    return active_kernels;
+}
+
+//Forces a kernel set by name ("scalar", "sse", "avx2", "avx512"), or the best
+//supported one for NULL, on the calling thread. Returns false if the CPU or build lacks it.
+bool vector_simd_select(const char *isa){
+    active_kernels = NULL;
+    if (isa == NULL){
+        vector_kernels();
+        return true;
+    }
+    if (strcmp(isa, "scalar") == 0){
+        active_kernels = &scalar_kernels;
+        return true;
+    }
+#ifdef DYNC_X86_SIMD
+    if (strcmp(isa, "sse") == 0 && __builtin_cpu_supports("sse2")){
+        active_kernels = &sse_kernels;
+        return true;
+    }
+    if (strcmp(isa, "avx2") == 0 && __builtin_cpu_supports("avx2")){
+        active_kernels = &avx2_kernels;
+        return true;
+    }
+    if (strcmp(isa, "avx512") == 0 && __builtin_cpu_supports("avx512f")){
+        active_kernels = &avx512_kernels;
+        return true;
+    }
+#endif
+    vector_kernels();
+    return false;
+}
+
+const char *vector_simd_name(void){
+    return vector_kernels() -> name;
+}
+
+//Element-wise vector (op) scalar. Division by zero is the caller's job to rule out.
+static object_t *vector_scalar_arith(object_t *vec, float scalar, arith_op_t op){
+    size_t dimensions = vec -> data.v_vector.dimensions;
+    object_t *result = new_object_vector_uninit(dimensions);
+    if (result == NULL){
+        return NULL;
+    }
+    vector_kernels() -> vs[op](result -> data.v_vector.coords, vec -> data.v_vector.coords, scalar, dimensions);
+    return result;
+}
+
+static object_t *vector_vector_arith(object_t *a, object_t *b, arith_op_t op){
+    size_t dimensions = a -> data.v_vector.dimensions;
+    object_t *result = new_object_vector_uninit(dimensions);
+    if (result == NULL){
+        return NULL;
+    }
+    vector_kernels() -> vv[op](result -> data.v_vector.coords, a -> data.v_vector.coords, b -> data.v_vector.coords, dimensions);
+    return result;
+}
+
+//Reads an INTEGER or FLOAT as a float
+static inline float object_scalar(object_t *obj){
+    return object_kind(obj) == INTEGER ? (float)object_int(obj) : object_float(obj);
+}
+
+// ======= VECTOR REDUCTIONS =======
+// dot, norm, sum, min, max and axpy run the selected SIMD kernel directly on
+// coords, so nothing intermediate is materialised. From VECTOR_PARALLEL_THRESHOLD
+// elements up the work is split into contiguous chunks across threads.
+#ifndef DYNC_NO_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define VECTOR_PARALLEL_THRESHOLD ((size_t)1 << 20)
+#define VECTOR_MAX_THREADS 8
+
+typedef enum {
+    REDUCE_DOT,
+    REDUCE_SUM,
+    REDUCE_MIN,
+    REDUCE_MAX,
+    REDUCE_AXPY,
+} reduce_op_t;
+
+typedef struct {
+    reduce_op_t op;
+    const float *a;
+    const float *b;
+    float *out;
+    float alpha;
+    size_t n;
+    float result;
+    const vector_kernels_t *kernels; //filled in by vector_run
+} vector_task_t;
+
+static void *vector_task_run(void *arg){
+    vector_task_t *task = arg;
+    const vector_kernels_t *kernels = task -> kernels;
+    switch(task -> op){
+        case REDUCE_DOT:
+            task -> result = kernels -> dot(task -> a, task -> b, task -> n);
+            break;
+        case REDUCE_SUM:
+            task -> result = kernels -> sum(task -> a, task -> n);
+            break;
+        case REDUCE_MIN:
+            task -> result = kernels -> min(task -> a, task -> n);
+            break;
+        case REDUCE_MAX:
+            task -> result = kernels -> max(task -> a, task -> n);
+            break;
+        case REDUCE_AXPY:
+            kernels -> axpy(task -> out, task -> alpha, task -> a, task -> b, task -> n);
+            break;
+    }
+    return NULL;
+}
+
+static size_t vector_thread_count(size_t n){
+#ifndef DYNC_NO_THREADS
+    if (n >= VECTOR_PARALLEL_THRESHOLD){
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t threads = cpus > 1 ? (size_t)cpus : 1;
+        size_t by_size = n / (VECTOR_PARALLEL_THRESHOLD / 2);
+        threads = threads < by_size ? threads : by_size;
+        return threads < VECTOR_MAX_THREADS ? threads : VECTOR_MAX_THREADS;
+    }
+#endif
+    (void)n;
+    return 1;
+}
+
+#ifndef DYNC_NO_THREADS
+//Worker threads are started on the first parallel reduction and then parked on
+//'work' between calls instead of being created and joined every time. One batch
+//runs at a time; a caller that finds the pool busy runs its chunks itself.
+typedef struct {
+    pthread_mutex_t submit; //held by the thread whose batch is running
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    size_t workers;
+    vector_task_t *tasks;
+    size_t task_count;
+    size_t next; //first task nobody has claimed yet
+    size_t pending; //claimed or not, tasks that have not finished
+} vector_pool_t;
+
+static vector_pool_t vector_pool = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,
+    0, NULL, 0, 0, 0,
+};
+
+//Claims and runs tasks of the current batch until none are left unclaimed.
+//Called and returns with vector_pool.lock held.
+static void vector_pool_drain(void){
+    while (vector_pool.next < vector_pool.task_count){
+        vector_task_t *task = &vector_pool.tasks[vector_pool.next++];
+        pthread_mutex_unlock(&vector_pool.lock);
+        vector_task_run(task);
+        pthread_mutex_lock(&vector_pool.lock);
+        if (--vector_pool.pending == 0){
+            pthread_cond_signal(&vector_pool.done);
+        }
+    }
+}
+
+static void *vector_pool_worker(void *arg){
+    (void)arg;
+    pthread_mutex_lock(&vector_pool.lock);
+    while (true){
+        while (vector_pool.next >= vector_pool.task_count){
+            pthread_cond_wait(&vector_pool.work, &vector_pool.lock);
+        }
+        vector_pool_drain();
+    }
+    return NULL;
+}
+
+//Runs tasks[0..count) on the pool, with the calling thread taking its share
+static void vector_pool_run(vector_task_t *tasks, size_t count){
+    if (pthread_mutex_trylock(&vector_pool.submit) != 0){
+        for (size_t t = 0; t < count; t++){
+            vector_task_run(&tasks[t]);
+        }
+        return;
+    }
+    pthread_mutex_lock(&vector_pool.lock);
+    //if no worker can be started the caller drains the batch alone
+    while (vector_pool.workers < count - 1){
+        pthread_t id;
+        if (pthread_create(&id, NULL, vector_pool_worker, NULL) != 0){
+            break;
+        }
+        pthread_detach(id);
+        vector_pool.workers++;
+    }
+    vector_pool.tasks = tasks;
+    vector_pool.task_count = count;
+    vector_pool.next = 0;
+    vector_pool.pending = count;
+    pthread_cond_broadcast(&vector_pool.work);
+    vector_pool_drain();
+    while (vector_pool.pending > 0){
+        pthread_cond_wait(&vector_pool.done, &vector_pool.lock);
+    }
+    vector_pool.tasks = NULL;
+    vector_pool.task_count = 0;
+    vector_pool.next = 0;
+    pthread_mutex_unlock(&vector_pool.lock);
+    pthread_mutex_unlock(&vector_pool.submit);
+}
+#endif
+
+//Runs 'job' over its n elements, in chunks on several threads if it is big enough,
+//and folds the partial results back into job -> result. n must be > 0.
+static void vector_run(vector_task_t *job){
+    //the workers run the calling thread's kernels
+    job -> kernels = vector_kernels();
+    size_t threads = vector_thread_count(job -> n);
+    if (threads <= 1){
+        vector_task_run(job);
+        return;
+    }
+#ifndef DYNC_NO_THREADS
+    vector_task_t tasks[VECTOR_MAX_THREADS];
+    size_t chunk = job -> n / threads;
+
+    for (size_t t = 0; t < threads; t++){
+        size_t start = t * chunk;
+        tasks[t] = *job;
+        tasks[t].n = (t == threads - 1) ? job -> n - start : chunk;
+        tasks[t].a = job -> a + start;
+        tasks[t].b = job -> b != NULL ? job -> b + start : NULL;
+        tasks[t].out = job -> out != NULL ? job -> out + start : NULL;
+    }
+    vector_pool_run(tasks, threads);
+
+    job -> result = tasks[0].result;
+    for (size_t t = 1; t < threads; t++){
+        float part = tasks[t].result;
+        switch(job -> op){
+            case REDUCE_DOT:
+            case REDUCE_SUM:
+                job -> result += part;
+                break;
+            case REDUCE_MIN:
+                job -> result = isnan(part) || part < job -> result ? part : job -> result;
+                break;
+            case REDUCE_MAX:
+                job -> result = isnan(part) || part > job -> result ? part : job -> result;
+                break;
+            case REDUCE_AXPY:
+                break;
+        }
+    }
+#endif
+}
+
+static bool require_vector(object_t *obj, const char *operation){
+    if (obj == NULL){
+        fprintf(stderr, "Cannot perform operation on Null data\n");
+        return false;
+    }
+    if (object_kind(obj) != VECTOR){
+        fprintf(stderr, "Cannot perform %s on non_vector kind\n", operation);
+        return false;
+    }
+    return true;
+}
+
+//Dot product of two vectors of the same dimensions, as a FLOAT
+object_t *vector_dot(object_t *a, object_t *b){
+    if (!require_vector(a, "dot product") || !require_vector(b, "dot product")){
+        return NULL;
+    }
+    if (a -> data.v_vector.dimensions != b -> data.v_vector.dimensions){
+        fprintf(stderr, "Cannot perform dot product on vectors in different dimensions\n");
+        return NULL;
+    }
+    if (a -> data.v_vector.dimensions == 0){
+        return new_object_float(0.0f);
+    }
+    vector_task_t job = {REDUCE_DOT, a -> data.v_vector.coords, b -> data.v_vector.coords, NULL, 0.0f, a -> data.v_vector.dimensions, 0.0f, NULL};
+    vector_run(&job);
+    return new_object_float(job.result);
+}
+
+//Euclidean (L2) norm, as a FLOAT
+object_t *vector_norm(object_t *v){
+    if (!require_vector(v, "norm")){
+        return NULL;
+    }
+    if (v -> data.v_vector.dimensions == 0){
+        return new_object_float(0.0f);
+    }
+    vector_task_t job = {REDUCE_DOT, v -> data.v_vector.coords, v -> data.v_vector.coords, NULL, 0.0f, v -> data.v_vector.dimensions, 0.0f, NULL};
+    vector_run(&job);
+    return new_object_float(sqrtf(job.result));
+}
+
+//Sum of all coords, as a FLOAT
+object_t *vector_sum(object_t *v){
+    if (!require_vector(v, "sum")){
+        return NULL;
+    }
+    if (v -> data.v_vector.dimensions == 0){
+        return new_object_float(0.0f);
+    }
+    vector_task_t job = {REDUCE_SUM, v -> data.v_vector.coords, NULL, NULL, 0.0f, v -> data.v_vector.dimensions, 0.0f, NULL};
+    vector_run(&job);
+    return new_object_float(job.result);
+}
+
+static object_t *vector_extreme(object_t *v, reduce_op_t op, const char *operation){
+    if (!require_vector(v, operation)){
+        return NULL;
+    }
+    if (v -> data.v_vector.dimensions == 0){
+        fprintf(stderr, "Cannot perform %s on empty vector\n", operation);
+        return NULL;
+    }
+    vector_task_t job = {op, v -> data.v_vector.coords, NULL, NULL, 0.0f, v -> data.v_vector.dimensions, 0.0f, NULL};
+    vector_run(&job);
+    return new_object_float(job.result);
+}
+
+//Smallest coord, as a FLOAT
+object_t *vector_min(object_t *v){
+    return vector_extreme(v, REDUCE_MIN, "min");
+}
+
+//Largest coord, as a FLOAT
+object_t *vector_max(object_t *v){
+    return vector_extreme(v, REDUCE_MAX, "max");
+}
+
+//alpha * x + y in a single pass, without the alpha * x temporary.
+//alpha is an INTEGER or FLOAT, x and y are vectors of the same dimensions.
+object_t *vector_axpy(object_t *alpha, object_t *x, object_t *y){
+    if (alpha == NULL || (object_kind(alpha) != INTEGER && object_kind(alpha) != FLOAT)){
+        fprintf(stderr, "Cannot perform axpy with non-scalar alpha\n");
+        return NULL;
+    }
+    if (!require_vector(x, "axpy") || !require_vector(y, "axpy")){
+        return NULL;
+    }
+    if (x -> data.v_vector.dimensions != y -> data.v_vector.dimensions){
+        fprintf(stderr, "Cannot perform axpy on vectors in different dimensions\n");
+        return NULL;
+    }
+    size_t dimensions = x -> data.v_vector.dimensions;
+    object_t *result = new_object_vector_uninit(dimensions);
+    if (result == NULL || dimensions == 0){
+        return result;
+    }
+    vector_task_t job = {REDUCE_AXPY, x -> data.v_vector.coords, y -> data.v_vector.coords, result -> data.v_vector.coords, object_scalar(alpha), dimensions, 0.0f, NULL};
+    vector_run(&job);
+    return result;
+}
+
+// ======= MATRIX KERNELS =======
+// C = A * B is computed in MATMUL_BLOCK_ROWS x MATMUL_BLOCK_DEPTH x MATMUL_BLOCK_COLS
+// tiles so the slice of B being streamed stays in cache while every row of the A
+// tile is applied to it. The innermost step, C[i, j..] += A[i, k] * B[k, j..], is
+// the selected SIMD axpy kernel running in place over a contiguous row segment.
+#define MATMUL_BLOCK_ROWS 64
+#define MATMUL_BLOCK_DEPTH 128
+#define MATMUL_BLOCK_COLS 512
+
+//out (m x n) = a (m x k) * b (k x n), all row-major
+static void matmul_blocked(float *out, const float *a, const float *b, size_t m, size_t k, size_t n){
+    vector_axpy_kernel_t axpy = vector_kernels() -> axpy;
+    memset(out, 0, sizeof(float) * m * n);
+
+    for (size_t i0 = 0; i0 < m; i0 += MATMUL_BLOCK_ROWS){
+        size_t i1 = i0 + MATMUL_BLOCK_ROWS < m ? i0 + MATMUL_BLOCK_ROWS : m;
+        for (size_t k0 = 0; k0 < k; k0 += MATMUL_BLOCK_DEPTH){
+            size_t k1 = k0 + MATMUL_BLOCK_DEPTH < k ? k0 + MATMUL_BLOCK_DEPTH : k;
+            for (size_t j0 = 0; j0 < n; j0 += MATMUL_BLOCK_COLS){
+                size_t width = j0 + MATMUL_BLOCK_COLS < n ? MATMUL_BLOCK_COLS : n - j0;
+                for (size_t i = i0; i < i1; i++){
+                    float *c_row = out + i * n + j0;
+                    for (size_t p = k0; p < k1; p++){
+                        axpy(c_row, a[i * k + p], b + p * n + j0, c_row, width);
+                    }
+                }
+            }
+        }
+    }
+}
+
+//out (m) = a (m x n) * x (n): one SIMD dot product per contiguous row
+static void matvec_rows(float *out, const float *a, const float *x, size_t m, size_t n){
+    vector_dot_kernel_t dot = vector_kernels() -> dot;
+    for (size_t i = 0; i < m; i++){
+        out[i] = dot(a + i * n, x, n);
+    }
+}
+
+//MATRIX * MATRIX gives a MATRIX, MATRIX * VECTOR gives a VECTOR.
+//Inner dimensions must agree. Neither operand is consumed.
+object_t *matrix_multiply(object_t *a, object_t *b){
+    if (a == NULL || b == NULL){
+        fprintf(stderr, "Cannot perform operation on Null data\n");
+        return NULL;
+    }
+    if (object_kind(a) != MATRIX){
+        fprintf(stderr, "Cannot perform matrix multiplication on non_matrix kind\n");
+        return NULL;
+    }
+    size_t m = a -> data.v_matrix.rows;
+    size_t k = a -> data.v_matrix.cols;
+
+    switch(object_kind(b)){
+        case MATRIX:{
+            if (b -> data.v_matrix.rows != k){
+                fprintf(stderr, "Cannot multiply %zux%zu matrix by %zux%zu matrix\n", m, k, b -> data.v_matrix.rows, b -> data.v_matrix.cols);
+                return NULL;
+            }
+            size_t n = b -> data.v_matrix.cols;
+            object_t *result = new_object_matrix_uninit(m, n);
+            if (result == NULL){
+                return NULL;
+            }
+            matmul_blocked(result -> data.v_matrix.values, a -> data.v_matrix.values, b -> data.v_matrix.values, m, k, n);
+            return result;
+        }
+        case VECTOR:{
+            if (b -> data.v_vector.dimensions != k){
+                fprintf(stderr, "Cannot multiply %zux%zu matrix by %zu dimensional vector\n", m, k, b -> data.v_vector.dimensions);
+                return NULL;
+            }
+            object_t *result = new_object_vector_uninit(m);
+            if (result == NULL){
+                return NULL;
+            }
+            matvec_rows(result -> data.v_vector.coords, a -> data.v_matrix.values, b -> data.v_vector.coords, m, k);
+            return result;
+        }
+        default:
+            fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
+            return NULL;
+    }
+}
+
+//The VECTOR branch shared by object_add/subtract/multiply/divide.
+//Neither operand is consumed, on failure too.
+static object_t *vector_arith(object_t *a, object_t *b, arith_op_t op){
+    static const char *const op_names[] = {"addition", "subtraction", "multiplication", "division"};
+
+    switch(object_kind(b)){
+        case INTEGER:
+        case FLOAT:{
+            float scalar = object_scalar(b);
+            if (op == ARITH_DIV && scalar == 0.0f){
+                fprintf(stderr, "Division by zero error");
+                return NULL;
+            }
+            return vector_scalar_arith(a, scalar, op);
+        }
+        case VECTOR:{
+            if (a -> data.v_vector.dimensions != b -> data.v_vector.dimensions){
+                fprintf(stderr, "Cannot perform element wise %s on vectors in different dimenstions", op_names[op]);
+                return NULL;
+            }
+            if (op == ARITH_DIV){
+                for (size_t j = 0; j < b -> data.v_vector.dimensions; j++){
+                    if (b -> data.v_vector.coords[j] == 0.0f){
+                        fprintf(stderr, "Division by zero error");
+                        return NULL;
+                    }
+                }
+            }
+            return vector_vector_arith(a, b, op);
+        }
+        default:
+            fprintf(stderr,"Incompatible kinds");
+            return NULL;
+    }
+}
+
+// ======= LAZY VECTOR EXPRESSIONS =======
+// On a VM with lazy_vectors set, element-wise vector arithmetic does not compute
+// anything: it pushes a VECTOR_EXPR node owning its operands. Whatever finally
+// needs the values (print, a reduction, building a collection, halting) forces
+// the tree, which runs in one fused pass: VECTOR_EXPR_CHUNK elements at a time,
+// every node writes its chunk into a small scratch buffer that stays in L1 and
+// the root writes straight into the single result vector. So v + 1.0 * 2.0 - w
+// costs one allocation and one sweep over coords instead of three of each.
+#define VECTOR_EXPR_CHUNK 256
+#define VECTOR_EXPR_MAX_NODES 16 //bigger trees are forced before growing further
+
+static inline bool is_vector_like(object_t *obj){
+    object_kind_t kind = object_kind(obj);
+    return kind == VECTOR || kind == VECTOR_EXPR;
+}
+
+static inline size_t vector_like_dimensions(object_t *obj){
+    return object_kind(obj) == VECTOR ? obj -> data.v_vector.dimensions : obj -> data.v_expr.dimensions;
+}
+
+static inline size_t vector_like_nodes(object_t *obj){
+    return object_kind(obj) == VECTOR_EXPR ? obj -> data.v_expr.nodes : 0;
+}
+
+//Builds 'a (op) b' as an expression node that takes ownership of both operands.
+//Returns NULL, leaving the operands untouched, if they don't qualify for deferral
+//(mismatched kinds or dimensions, zero scalar divisor, tree too big).
+static object_t *vector_expr_build(object_t *a, object_t *b, arith_op_t op){
+    if (!is_vector_like(a)){
+        return NULL;
+    }
+    size_t dimensions = vector_like_dimensions(a);
+    switch(object_kind(b)){
+        case INTEGER:
+        case FLOAT:
+            if (op == ARITH_DIV && object_scalar(b) == 0.0f){
+                return NULL;
+            }
+            break;
+        case VECTOR:
+        case VECTOR_EXPR:
+            if (vector_like_dimensions(b) != dimensions){
+                return NULL;
+            }
+            break;
+        default:
+            return NULL;
+    }
+    size_t nodes = vector_like_nodes(a) + vector_like_nodes(b) + 1;
+    if (nodes > VECTOR_EXPR_MAX_NODES){
+        return NULL;
+    }
+
+    object_t *node = object_new(OBJECT_SIZE_OF(v_expr), VECTOR_EXPR);
+    if (node == NULL){
+        return NULL;
+    }
+    node -> data.v_expr.op = op;
+    node -> data.v_expr.dimensions = dimensions;
+    node -> data.v_expr.nodes = nodes;
+    node -> data.v_expr.left = a;
+    node -> data.v_expr.right = b;
+    return node;
+}
+
+//Evaluates elements [start, start + len) of 'node'. A VECTOR just hands back its
+//own coords. An expression node writes into 'out' when given one, otherwise into
+//scratch[0]; its left subtree evaluates into scratch[1..] and its right subtree
+//into the scratch buffers after the left one's. Returns NULL on division by zero.
+static const float *vector_expr_eval(object_t *node, size_t start, size_t len, float (*scratch)[VECTOR_EXPR_CHUNK], float *out){
+    if (object_kind(node) == VECTOR){
+        return node -> data.v_vector.coords + start;
+    }
+    vector_expr *expr = &node -> data.v_expr;
+    const vector_kernels_t *kernels = vector_kernels();
+    float *target = out != NULL ? out : scratch[0];
+
+    const float *left = vector_expr_eval(expr -> left, start, len, scratch + 1, NULL);
+    if (left == NULL){
+        return NULL;
+    }
+    if (!is_vector_like(expr -> right)){
+        kernels -> vs[expr -> op](target, left, object_scalar(expr -> right), len);
+        return target;
+    }
+    const float *right = vector_expr_eval(expr -> right, start, len, scratch + 1 + vector_like_nodes(expr -> left), NULL);
+    if (right == NULL){
+        return NULL;
+    }
+    if (expr -> op == ARITH_DIV){
+        for (size_t i = 0; i < len; i++){
+            if (right[i] == 0.0f){
+                fprintf(stderr, "Division by zero error");
+                return NULL;
+            }
+        }
+    }
+    kernels -> vv[expr -> op](target, left, right, len);
+    return target;
+}
+
+//Computes the VECTOR a VECTOR_EXPR stands for, in one fused pass.
+//The expression is left as is. Returns NULL if evaluation fails.
+static object_t *vector_expr_evaluate(object_t *expr){
+    size_t dimensions = expr -> data.v_expr.dimensions;
+    float scratch[VECTOR_EXPR_MAX_NODES][VECTOR_EXPR_CHUNK];
+    object_t *result = new_object_vector_uninit(dimensions);
+
+    for (size_t start = 0; result != NULL && start < dimensions; start += VECTOR_EXPR_CHUNK){
+        size_t len = dimensions - start < VECTOR_EXPR_CHUNK ? dimensions - start : VECTOR_EXPR_CHUNK;
+        if (vector_expr_eval(expr, start, len, scratch, result -> data.v_vector.coords + start) == NULL){
+            object_free(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+//Forces *slot in place if it holds an expression. On failure *slot becomes NULL.
+static bool force_vector_expr(object_t **slot){
+    if (*slot == NULL || object_kind(*slot) != VECTOR_EXPR){
+        return true;
+    }
+    object_t *result = vector_expr_evaluate(*slot);
+    object_free(*slot);
+    *slot = result;
+    return result != NULL;
+}
+
+//Copies an arena object, and everything it holds, out to the heap so it survives
+//object_arena_reset. Use it in place of the reference being given up: heap objects
+//and immediates come back as they are, arena objects as a new heap copy.
+object_t *object_promote(object_t *obj){
+    if (obj == NULL || object_is_immediate(obj) || !(obj -> flags & OBJ_FLAG_ARENA)){
+        return obj;
+    }
+    object_arena_t *arena = object_arena_activate(NULL);
+    object_t *copy = NULL;
+    switch (object_kind(obj)){
+        case INTEGER:
+            copy = new_object_integer(object_int(obj));
+            break;
+        case FLOAT:
+            copy = new_object_float(object_float(obj));
+            break;
+        case STRING:
+            //arena strings are always flat
+            copy = new_object_string_n(obj -> data.v_string.chars, obj -> data.v_string.length);
+            break;
+        case VECTOR:
+            copy = new_object_vector(obj -> data.v_vector.dimensions, obj -> data.v_vector.coords);
+            break;
+        case MATRIX:
+            copy = new_object_matrix(obj -> data.v_matrix.rows, obj -> data.v_matrix.cols, obj -> data.v_matrix.values);
+            break;
+        case VECTOR_EXPR:
+            copy = vector_expr_evaluate(obj);
+            break;
+        case COLLECTION:{
+            size_t length = obj -> data.v_collection.length;
+            copy = collection_new(length > 0 ? length : 1, obj -> data.v_collection.stack, obj -> data.v_collection.items);
+            if (copy != NULL && obj -> data.v_collection.items != ITEMS_BOXED){
+                //packed values hold nothing in the region, copy them wholesale
+                if (collection_extend(copy, obj) != 0){
+                    object_free(copy);
+                    copy = NULL;
+                }
+                break;
+            }
+            for (size_t i = 0; copy != NULL && i < length; i++){
+                object_t *item = object_promote(collection_item(obj, i));
+                if (item == NULL || collection_append(copy, item) != 0){
+                    object_free(item);
+                    object_free(copy);
+                    copy = NULL;
+                }
+            }
+            break;
+        }
+        case DICT:
+        case SET:
+            copy = dict_new(obj -> data.v_dict.length, object_kind(obj));
+            for (size_t i = 0; copy != NULL && i < obj -> data.v_dict.capacity; i++){
+                dict_slot_t *slot = &obj -> data.v_dict.slots[i];
+                if (slot -> key == NULL){
+                    continue;
+                }
+                object_t *key = object_promote(slot -> key);
+                object_t *value = object_promote(slot -> value);
+                if (key == NULL || (value == NULL) != (slot -> value == NULL) || dict_insert(copy, key, value, slot -> hash) != 0){
+                    object_free(key);
+                    object_free(value);
+                    object_free(copy);
+                    copy = NULL;
+                }
+            }
+            break;
+        case DEQUE:
+            copy = new_object_deque(obj -> data.v_deque.length);
+            for (size_t i = 0; copy != NULL && i < obj -> data.v_deque.length; i++){
+                object_t *item = object_promote(deque_item(obj, i));
+                if (item == NULL || deque_push_back(copy, item) != 0){
+                    object_free(item);
+                    object_free(copy);
+                    copy = NULL;
+                }
+            }
+            break;
+        case PLIST:{
+            size_t length = obj -> data.v_plist.length;
+            object_t **items = malloc(sizeof(object_t *) * (length > 0 ? length : 1));
+            size_t promoted = 0;
+            //like the other containers: a heap item's reference is the arena list's, taken over
+            while (items != NULL && promoted < length){
+                items[promoted] = object_promote(plist_item(obj, promoted));
+                if (items[promoted] == NULL){
+                    break;
+                }
+                promoted++;
+            }
+            if (items != NULL && promoted == length){
+                plist_node_t *root = length > 0 ? plist_build(items, length) : NULL;
+                copy = length == 0 || root != NULL ? plist_wrap(root) : NULL;
+            }
+            for (size_t i = 0; items != NULL && i < promoted; i++){
+                object_free(items[i]);
+            }
+            free(items);
+            break;
+        }
+        default:
+            break;
+    }
+    object_arena_activate(arena);
+    return copy;
+}
+
+object_t *object_add(object_t *a, object_t *b){
+        /**
+     * @brief Performs a polymorphic addition or collection merge.
+     *
+     * @details
+     * - **Primitives (INT/FLOAT):** Returns a new object. 'a' and 'b' remain valid.
+     * - **Strings:** Returns a new string. 'a' and 'b' remain valid.
+     * - **Collections:** A new collection holding ALL items from 'a' and 'b'.
+     *   The items are **shared** (retained), not copied, and 'a' and 'b' remain valid.
+     * - **Persistent lists:** A new version sharing the tree nodes of both, O(log n).
+     *
+     * @param a The first operand. Never consumed.
+     * @param b The second operand. Never consumed.
+     * @return object_t* A new object containing the result, or NULL on failure.
+     */
+    if (a == NULL || b == NULL){
+        fprintf(stderr, "Cannot perform operation on Null data\n");
+        return NULL;
+    }
+    
+    switch (object_kind(a)){
+        case INTEGER:
+            switch (object_kind(b)){
+                case INTEGER:
+                    return new_object_integer(object_int(a) + object_int(b));
+                case FLOAT:
+                    return new_object_float((float)object_int(a) + object_float(b));
+                default:
+                    fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
+                    return NULL;
+            }
+        case FLOAT:
+            switch (object_kind(b)){
+                case INTEGER:
+                    return new_object_float(object_float(a) + (float)object_int(b));
+                case FLOAT:
+                    return new_object_float(object_float(a) + object_float(b));
+                default:
+                    fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
+                    return NULL;
+            }
+
+        case STRING:{
+            if (object_kind(b) != STRING){
+                fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
+                return NULL;  
+            }
+            size_t length_a = a -> data.v_string.length;
+            size_t length_b = b -> data.v_string.length;
+
+            if (length_a + length_b >= rope_threshold && active_arena == NULL){
+                return string_concat_rope(a, b);
+            }
+            if (string_flatten(a) == NULL || string_flatten(b) == NULL){
+                return NULL;
+            }
+
+            //one copy of each operand, straight into the result
+            object_t *newstring = new_object_string_uninit(length_a + length_b);
+            if(newstring == NULL){
+                return NULL;
+            }
+
+            memcpy(newstring -> data.v_string.chars, a -> data.v_string.chars, length_a);
+            memcpy(newstring -> data.v_string.chars + length_a, b -> data.v_string.chars, length_b);
+
+            return newstring;
+        }
+        case COLLECTION:
+            if (object_kind(b) != COLLECTION){
+               fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
+               return NULL;          
+            }
+
+            if (a->data.v_collection.stack || b->data.v_collection.stack){
+                fprintf(stderr, "object_add: can only concatenate non-stack collections (lists)\n");
+                return NULL;
+            }
+
+            size_t total_length = a -> data.v_collection.length + b -> data.v_collection.length;
+
+            size_t capacity = (total_length > 0) ? total_length : 1;
+            //sized once, stays packed when both sides are packed alike
+            uint8_t items = a -> data.v_collection.items == b -> data.v_collection.items ? a -> data.v_collection.items : ITEMS_BOXED;
+            object_t *new_collection = collection_new(capacity, false, items);
+            if (new_collection == NULL){
+                return NULL;
+            }
+
+            //the items are shared with the operands, which stay intact
+            if (collection_extend(new_collection, a) != 0 || collection_extend(new_collection, b) != 0){
+                object_free(new_collection);
+                return NULL;
+            }
+            return new_collection;
+        case VECTOR:
+            return vector_arith(a, b, ARITH_ADD);
+        case PLIST:
+            if (object_kind(b) != PLIST){
+                fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
+                return NULL;
+            }
+            return plist_concat(a, b);
+            
+        default: return NULL;
+    }
+
+
+}
+
+bool object_equals(object_t *a, object_t *b){
+    if (a == NULL || b == NULL){
+        return false;
+    }
+    
+    if (object_kind(a) != object_kind(b)){
+        return false;
+    }
+    switch (object_kind(a)){
+        case INTEGER:
+            if(object_int(a) == object_int(b)){
+                return true;
+            }
+            else{
+                return false;
+            }
+        case FLOAT:
+            if(object_float(a) == object_float(b)){
+                return true;
+            }
+            else{
+                return false;
+            }
+        case STRING:
+            if (string_is_interned(a) && string_is_interned(b)){
+                return a == b;
+            }
+            if (a -> data.v_string.length != b -> data.v_string.length){
+                return false;
+            }
+            if (string_flatten(a) == NULL || string_flatten(b) == NULL){
+                return false;
+            }
+            return memcmp(a -> data.v_string.chars, b -> data.v_string.chars, a -> data.v_string.length) == 0;
+        case COLLECTION:
+            if (b -> data.v_collection.length != a -> data.v_collection.length){
+                return false;
+            }
+            else if (a -> data.v_collection.data == b -> data.v_collection.data){
+                //clones sharing one item array
+                return true;
+            }
+            else{
+                for (size_t i = 0; i < b -> data.v_collection.length; i++){
+                    object_t *a_check = collection_item(a, i);
+                    object_t *b_check = collection_item(b, i);
+
+                    if (object_equals(a_check, b_check) == false){
+                        return false;
+                    }
+                    
+                }
+                return true;
+            }
+        case VECTOR:
+            if (a -> data.v_vector.dimensions != b -> data.v_vector.dimensions){
+                return false;
+            }
+            return memcmp(a -> data.v_vector.coords, b -> data.v_vector.coords, sizeof(float) * a -> data.v_vector.dimensions) == 0;
+        case MATRIX:
+            if (a -> data.v_matrix.rows != b -> data.v_matrix.rows || a -> data.v_matrix.cols != b -> data.v_matrix.cols){
+                return false;
+            }
+            return memcmp(a -> data.v_matrix.values, b -> data.v_matrix.values, sizeof(float) * a -> data.v_matrix.rows * a -> data.v_matrix.cols) == 0;
+        case DICT:
+            if (a -> data.v_dict.length != b -> data.v_dict.length){
+                return false;
+            }
+            for (size_t i = 0; i < a -> data.v_dict.capacity; i++){
+                dict_slot_t *slot = &a -> data.v_dict.slots[i];
+                if (slot -> key != NULL && !object_equals(slot -> value, dict_get(b, slot -> key))){
+                    return false;
+                }
+            }
+            return true;
+        case SET:
+            if (a -> data.v_dict.length != b -> data.v_dict.length){
+                return false;
+            }
+            for (size_t i = 0; i < a -> data.v_dict.capacity; i++){
+                dict_slot_t *slot = &a -> data.v_dict.slots[i];
+                if (slot -> key != NULL && dict_find(b, slot -> key, slot -> hash) == NULL){
+                    return false;
+                }
+            }
+            return true;
+        case DEQUE:
+            if (a -> data.v_deque.length != b -> data.v_deque.length){
+                return false;
+            }
+            for (size_t i = 0; i < a -> data.v_deque.length; i++){
+                if (!object_equals(deque_item(a, i), deque_item(b, i))){
+                    return false;
+                }
+            }
+            return true;
+        case PLIST:
+            if (a -> data.v_plist.length != b -> data.v_plist.length){
+                return false;
+            }
+            if (a -> data.v_plist.root == b -> data.v_plist.root){
+                //versions sharing all their structure
+                return true;
+            }
+            for (size_t i = 0; i < a -> data.v_plist.length; i++){
+                if (!object_equals(plist_item(a, i), plist_item(b, i))){
+                    return false;
+                }
+            }
+            return true;
+        default:
+            return false;
+
+    }
+    return false;
+}
+
+object_t *object_clone(object_t *obj){
+    if (obj == NULL){
+        fprintf(stderr, "Cannot perform operation on Null data\n");
+        return NULL;   
+    }
+    switch(object_kind(obj)){
+        case INTEGER:
+            return new_object_integer(object_int(obj));
+        case FLOAT:
+            return new_object_float(object_float(obj));
+        case STRING:
+        case VECTOR:
+        case MATRIX:
+        case PLIST:
+            //immutable once built, the clone is the same object with one more owner
+            return object_retain(obj);
+        case COLLECTION:
+            //shares the item array until either side writes to it
+            return collection_share(obj);
+        case DICT:
+        case SET:
+            return dict_copy(obj);
+        case DEQUE:
+            return deque_copy(obj);
+        default:
+            return NULL;
+            
+    }
+    return NULL;
+}
+
+object_t *object_subtract(object_t *a, object_t *b){
+     if (a == NULL || b == NULL){
+        fprintf(stderr, "Cannot perform operation on Null data\n");
+        return NULL;
+    }
+    switch(object_kind(a)){
+        case INTEGER:
+            switch (object_kind(b)){
+                case INTEGER:
+                    return new_object_integer(object_int(a) - object_int(b));
+                case FLOAT:
+                    return new_object_float((float)object_int(a) - object_float(b));
+                default:
+                    fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
+                    return NULL;
+            }
+        case FLOAT:
+            switch (object_kind(b)){
+                case INTEGER:
+                    return new_object_float(object_float(a) - (float)object_int(b));
+                case FLOAT:
+                    return new_object_float(object_float(a) - object_float(b));
+                default:
+                    fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
+                    return NULL;
+            }
+        case STRING:
+            fprintf(stderr, "Cannot perform subtraction operation on String kind");
+            return NULL;
+
+        case COLLECTION:
+             if (object_kind(b) != COLLECTION){
+               fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
+               return NULL;          
+            }
+
+            if (a -> data.v_collection.stack == false ||b -> data.v_collection.stack == false ){
+               fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
+               return NULL;  
+
+            }
+
+            if (b -> data.v_collection.length >  a -> data.v_collection.length){
+                fprintf(stderr, "Subtraction Underflow error");
+                return NULL;
+            }
+            for (size_t i = 0; i < b -> data.v_collection.length; i++){
+                object_t *a_test = collection_item(a, a -> data.v_collection.length - 1 - i);
+                object_t *b_test = collection_item(b, i);
+                if (object_equals(a_test, b_test) == false){
+                    return NULL;
+                }
+            }
+            //pop from a copy, 'a' belongs to the caller (run_vm frees it right after)
+            object_t *remaining = collection_share(a);
+            if (remaining == NULL){
+                return NULL;
+            }
+            for (size_t i = 0; i < b -> data.v_collection.length; i++){
+                object_t *popped_item = collection_pop(remaining);
+                object_free(popped_item);
+            }
+            
+            return remaining;
+        case VECTOR:
+            return vector_arith(a, b, ARITH_SUB);
+            
+        default:
+            return NULL;
+    }
+    return NULL;
+}
+
+
+object_t *object_multiply(object_t *a, object_t *b){
+    if (a == NULL || b == NULL){
+        fprintf(stderr, "Cannot perform operation on Null data\n");
+        return NULL;
+    }
+    switch(object_kind(a)){
+        case INTEGER:
+            switch (object_kind(b)){
+                case INTEGER:
+                    return new_object_integer(object_int(a) * object_int(b));
+                case FLOAT:
+                    return new_object_float((float)object_int(a) * object_float(b));
+                default:
+                    fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
+                    return NULL;
+            }
+        case FLOAT:
+            switch (object_kind(b)){
+                case INTEGER:
+                    return new_object_float(object_float(a) * (float)object_int(b));
+                case FLOAT:
+                    return new_object_float(object_float(a) * object_float(b));
+                default:
+                    fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
+                    return NULL;
+            }
+        case STRING:{
+            if (object_kind(b) !=  INTEGER || object_int(b) <= 0){
+                fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
+                return NULL;  
+            }
+            if (string_flatten(a) == NULL){
+                return NULL;
+            }
+            size_t chunk_size = a -> data.v_string.length;
+            size_t offset = 0;
+            size_t repeats = (size_t)object_int(b);
+
+            object_t *newstring = new_object_string_uninit(chunk_size * repeats);
+            if(newstring == NULL){
+                return NULL;
+            }
+            for (size_t i = 0; i < repeats; i++){
+                 memcpy(newstring -> data.v_string.chars + offset, a -> data.v_string.chars, chunk_size);
+                 offset = offset + chunk_size;
+            }
+
+            return newstring;
+        }
+        case COLLECTION:{
+            if (object_kind(b) !=  INTEGER || object_int(b) <= 0){
+                fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
+                return NULL;  
+            }
+
+            size_t cap = a -> data.v_collection.length * object_int(b);
+            object_t *new_collection = collection_new(cap > 0 ? cap : 1, a -> data.v_collection.stack, a -> data.v_collection.items);
+            if (new_collection == NULL){
+                return NULL;
+            }
+
+            for (int i = 0; i < object_int(b); i++){
+                if (collection_extend(new_collection, a) != 0){
+                    object_free(new_collection);
+                    return NULL;
+                }
+            }
+            return new_collection;
+        }
+
+        case VECTOR:
+            return vector_arith(a, b, ARITH_MUL);
+            
+        default:
+            return NULL;
+    }
+}
+
+object_t *object_divide(object_t *a, object_t *b){
+    if (a == NULL || b == NULL){
+        fprintf(stderr, "Cannot perform operation on Null data\n");
+        return NULL;
+    }
+    switch(object_kind(a)){
         case INTEGER:
-            switch (b -> kind){
+            switch (object_kind(b)){
+                case INTEGER:
+                    if (object_int(b) == 0){
+                        fprintf(stderr, "VM ERROR: Division by zero");
+                        return NULL;
+                    }
+                    return new_object_integer(object_int(a) / object_int(b));
+                case FLOAT:
+                    if (object_float(b) == 0){
+                        fprintf(stderr, "VM ERROR: Division by zero");
+                        return NULL;
+                    }
+                    return new_object_float((float)object_int(a) / object_float(b));
+                default:
+                    fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
+                    return NULL;
+            }
+        case FLOAT:
+            switch (object_kind(b)){
                 case INTEGER:
-                    return new_object_integer(a -> data.v_int - b -> data.v_int);
+                    if (object_int(b) == 0){
+                        fprintf(stderr, "VM ERROR: Division by zero");
+                        return NULL;
+                    }
+                    return new_object_float(object_float(a) / (float)object_int(b));
                 case FLOAT:
-                    return new_object_float((float)a -> data.v_int - b -> data.v_float);
+                    if (object_float(b) == 0){
+                        fprintf(stderr, "VM ERROR: Division by zero");
+                        return NULL;
+                    }
+                    return new_object_float(object_float(a) / object_float(b));
                 default:
                     fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
                     return NULL;
             }
-        case FLOAT:
-            switch (b -> kind){
-                case INTEGER:
-                    return new_object_float(a -> data.v_float - (float)b -> data.v_int);
-                case FLOAT:
-                    return new_object_float(a -> data.v_float - b -> data.v_float);
-                default:
-                    fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
-                    return NULL;
+        case VECTOR:
+            return vector_arith(a, b, ARITH_DIV);
+            
+        case STRING:
+            fprintf(stderr, "Cannot perform division operation on string kind");
+            return NULL;
+        case COLLECTION:
+            fprintf(stderr, "Cannot perform division operation on Collection kind");
+            return NULL;
+
+        default:
+            fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
+            return NULL;    
+
+    }
+}
+
+
+
+
+void print_object(object_t *obj1){
+    if (obj1 == NULL){
+        printf("NULL");
+        return;
+    }
+
+    switch(object_kind(obj1)){
+        case INTEGER:
+            printf("%d", object_int(obj1));
+            break;
+        case FLOAT:
+            printf("%f", object_float(obj1));
+            break;
+        case STRING:
+            if (string_flatten(obj1) != NULL){
+                fwrite(obj1 -> data.v_string.chars, 1, obj1 -> data.v_string.length, stdout);
+            }
+            break;
+        case COLLECTION:
+            printf("[");
+            for (size_t i = 0; i < obj1 -> data.v_collection.length; i++){
+                print_object(collection_item(obj1, i));
+                if (i < obj1 -> data.v_collection.length - 1){
+                      printf(", ");
+                }
+
+            }
+            printf("]\n");
+            break;
+        case VECTOR:
+            printf("<");
+            for (size_t j = 0; j < obj1 -> data.v_vector.dimensions; j++){
+                printf("%f", obj1 -> data.v_vector.coords[j]);
+                if (j < obj1 -> data.v_vector.dimensions - 1){
+                    printf(",");
+                }
+            }
+            printf(">\n");
+            break;
+        case MATRIX:
+            printf("[");
+            for (size_t i = 0; i < obj1 -> data.v_matrix.rows; i++){
+                printf("<");
+                for (size_t j = 0; j < obj1 -> data.v_matrix.cols; j++){
+                    printf("%f", obj1 -> data.v_matrix.values[i * obj1 -> data.v_matrix.cols + j]);
+                    if (j < obj1 -> data.v_matrix.cols - 1){
+                        printf(",");
+                    }
+                }
+                printf(">");
+                if (i < obj1 -> data.v_matrix.rows - 1){
+                    printf(", ");
+                }
+            }
+            printf("]\n");
+            break;
+        case VECTOR_EXPR:{
+            object_t *value = vector_expr_evaluate(obj1);
+            print_object(value);
+            object_free(value);
+            break;
+        }
+        case DICT:
+        case SET:{
+            printf("{");
+            size_t printed = 0;
+            for (size_t i = 0; i < obj1 -> data.v_dict.capacity; i++){
+                dict_slot_t *slot = &obj1 -> data.v_dict.slots[i];
+                if (slot -> key == NULL){
+                    continue;
+                }
+                print_object(slot -> key);
+                if (object_kind(obj1) == DICT){
+                    printf(": ");
+                    print_object(slot -> value);
+                }
+                if (++printed < obj1 -> data.v_dict.length){
+                    printf(", ");
+                }
+            }
+            printf("}\n");
+            break;
+        }
+        case DEQUE:
+            printf("deque[");
+            for (size_t i = 0; i < obj1 -> data.v_deque.length; i++){
+                print_object(deque_item(obj1, i));
+                if (i < obj1 -> data.v_deque.length - 1){
+                    printf(", ");
+                }
+            }
+            printf("]\n");
+            break;
+        case PLIST:
+            printf("plist[");
+            for (size_t i = 0; i < obj1 -> data.v_plist.length; i++){
+                print_object(plist_item(obj1, i));
+                if (i < obj1 -> data.v_plist.length - 1){
+                    printf(", ");
+                }
+            }
+            printf("]\n");
+            break;
+    }
+
+}
+
+void print_collection_data(object_t *obj){
+    if (object_kind(obj) != COLLECTION){
+        fprintf(stderr, "Cannot print data of non_collection kind");
+        return;
+    }
+
+    printf("Collection capacity: %zu\n", obj -> data.v_collection.capacity);
+    printf("Number of items in collection: %zu\n", obj -> data.v_collection.length);
+    switch (obj -> data.v_collection.items){
+        case ITEMS_INT:
+            printf("Item storage: packed int32\n");
+            break;
+        case ITEMS_FLOAT:
+            printf("Item storage: packed float\n");
+            break;
+        default:
+            printf("Item storage: boxed\n");
+            break;
+    }
+    if (view_base(obj) != NULL){
+        object_t *base = view_base(obj);
+        size_t offset = ((char *)obj -> data.v_collection.data - (char *)base -> data.v_collection.data) / collection_item_size(obj -> data.v_collection.items);
+        printf("View of items %zu to %zu of a %zu item collection\n", offset, offset + obj -> data.v_collection.length, base -> data.v_collection.length);
+    }
+
+}
+
+
+int is_full(object_t *obj){
+    if (object_kind(obj) != COLLECTION){
+        fprintf(stderr, "Object of non_collection kind cannot be empty");
+        return -1;
+    }
+
+    if(obj -> data.v_collection.length == obj -> data.v_collection.capacity){
+        return 1;
+    }
+    return 0;
+
+}
+
+#define VM_INITIAL_STACK 256
+
+vm_t *new_virtual_machine(size_t *code){
+    vm_t *vm = malloc(sizeof(vm_t));
+    if (vm == NULL){
+        fprintf(stderr, "Memory allocation failed");
+        return NULL;
+    }
+
+    vm -> ip = 0;
+    vm -> bytecode = code;
+    vm -> sp = 0;
+    vm -> stack_capacity = VM_INITIAL_STACK;
+    vm -> lazy_vectors = false;
+    vm -> arena = NULL;
+    vm -> stack = malloc(sizeof(object_t *) * VM_INITIAL_STACK);
+
+    if (vm -> stack == NULL){
+        free(vm);
+        return NULL;
+    }
+
+    return vm;
+}
+
+//Frees the VM together with anything still left on its operand stack
+void free_virtual_machine(vm_t *vm){
+    if (vm == NULL){
+        return;
+    }
+    for (size_t i = 0; i < vm -> sp; i++){
+        object_free(vm -> stack[i]);
+    }
+    free_object_arena(vm -> arena);
+    gc_unregister_vm(vm);
+    free(vm -> stack);
+    free(vm);
+}
+
+//Arena mode: every object a run_vm call creates comes from a region that is
+//released in one go when the run ends. Whatever is still on the stack by then is
+//promoted to the heap first, so the results stay usable.
+bool vm_set_arena(vm_t *vm, bool enabled){
+    if (vm == NULL){
+        return false;
+    }
+    if (!enabled){
+        free_object_arena(vm -> arena);
+        vm -> arena = NULL;
+        return true;
+    }
+    if (vm -> arena == NULL){
+        vm -> arena = new_object_arena();
+    }
+    return vm -> arena != NULL;
+}
+
+//Makes room for at least 'extra' more slots. Only called off the fast path.
+static bool vm_reserve_stack(vm_t *vm, size_t extra){
+    if (vm -> sp + extra <= vm -> stack_capacity){
+        return true;
+    }
+    size_t new_cap = vm -> stack_capacity * 2;
+    while (new_cap < vm -> sp + extra){
+        new_cap *= 2;
+    }
+    object_t **temp = realloc(vm -> stack, sizeof(object_t *) * new_cap);
+    if (temp == NULL){
+        fprintf(stderr, "VM Error: Operand stack overflow\n");
+        return false;
+    }
+    vm -> stack = temp;
+    vm -> stack_capacity = new_cap;
+    return true;
+}
+
+//Unchecked push, the stack only grows when it is actually full.
+//On allocation failure the object is freed so it is never leaked.
+static inline void vm_push(vm_t *vm, object_t *obj){
+    if (vm -> sp == vm -> stack_capacity && !vm_reserve_stack(vm, 1)){
+        object_free(obj);
+        return;
+    }
+    vm -> stack[vm -> sp++] = obj;
+}
+
+//Unchecked pop, callers check vm -> sp for underflow first
+static inline object_t *vm_pop(vm_t *vm){
+    return vm -> stack[--vm -> sp];
+}
+
+//Materialises any deferred vector expressions among the top 'count' slots,
+//for opcodes that need real values. On failure the slot is left NULL.
+static bool vm_force(vm_t *vm, size_t count){
+    if (!vm -> lazy_vectors){
+        return true;
+    }
+    bool ok = true;
+    for (size_t i = vm -> sp - count; i < vm -> sp; i++){
+        if (!force_vector_expr(&vm -> stack[i])){
+            fprintf(stderr, "VM Error: Evaluating deferred vector expression failed.\n");
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+#ifndef DYNC_NO_QUICKEN
+//Picks the quickened form of a generic arithmetic opcode for the operand kinds
+//just seen at that site, or returns the generic opcode if none applies.
+static size_t quicken_binary(size_t generic, object_t *a, object_t *b, bool lazy_vectors){
+    size_t base;
+    switch(generic){
+        case OP_ADD: base = OP_ADD_INT_INT; break;
+        case OP_SUB: base = OP_SUB_INT_INT; break;
+        case OP_MUL: base = OP_MUL_INT_INT; break;
+        case OP_DIV: base = OP_DIV_INT_INT; break;
+        default: return generic;
+    }
+    object_kind_t kind_a = object_kind(a);
+    object_kind_t kind_b = object_kind(b);
+
+    if (kind_a == INTEGER && kind_b == INTEGER){
+        return base;
+    }
+    if (kind_a == FLOAT && kind_b == FLOAT){
+        return base + 1;
+    }
+    if (kind_a == VECTOR && (kind_b == INTEGER || kind_b == FLOAT) && !lazy_vectors){
+        return base + 2;
+    }
+    return generic;
+}
+#endif
+
+// At the start of a handler (and at the end of a quickened one) every live value
+// sits on the operand stack, which makes it a safe place for the tracing collector
+// to run. Only handlers that allocate objects check, so the immediate-only fast
+// paths never pay for it.
+#define VM_SAFEPOINT() do { \
+        if (gc_pending){ \
+            gc_collect(); \
+        } \
+    } while (0)
+
+// Instruction dispatch. With GCC/Clang every handler ends in its own indirect
+// jump through dispatch_table (computed goto), which gives the branch predictor
+// one history per opcode instead of a single shared switch jump. Other compilers,
+// or builds with -DDYNC_NO_COMPUTED_GOTO, use the portable switch loop.
+#if defined(__GNUC__) && !defined(DYNC_NO_COMPUTED_GOTO)
+#define DYNC_COMPUTED_GOTO 1
+#define VM_NEXT_THREADED() do { \
+        instruction = vm -> bytecode[vm -> ip++]; \
+        if (instruction >= OP_COUNT || dispatch_table[instruction] == NULL){ \
+            goto do_unknown_opcode; \
+        } \
+        goto *dispatch_table[instruction]; \
+    } while (0)
+#ifdef DYNC_BENCH
+//Benchmark builds carry both loops in one function so the dispatch benchmark can
+//time them side by side: every handler is a case label and a goto target, and
+//VM_NEXT picks the shared switch or the handler's own jump from a flag read once
+//on entry. Normal builds keep the threaded loop free of that test.
+#define DYNC_DUAL_DISPATCH 1
+static bool vm_switch_dispatch = false;
+#define VM_CASE(op) case op: do_##op
+#define VM_DEFAULT default: do_unknown_opcode
+#define VM_NEXT() do { \
+        if (switch_dispatch){ \
+            goto vm_switch_next; \
+        } \
+        VM_NEXT_THREADED(); \
+    } while (0)
+#else
+#define VM_CASE(op) do_##op
+#define VM_DEFAULT do_unknown_opcode
+#define VM_NEXT() VM_NEXT_THREADED()
+#endif
+#else
+#define VM_CASE(op) case op
+#define VM_DEFAULT default
+#define VM_NEXT() break
+#endif
+
+// Type feedback. After a generic arithmetic opcode succeeds it overwrites itself
+// in the bytecode with the form specialized for the kinds it just saw, so the
+// next execution of that site skips object_add's nested kind switch. A quickened
+// handler re-checks its guard and, on a miss, writes the generic opcode back and
+// re-dispatches it. Note this means run_vm writes to the bytecode array it was
+// given; build with -DDYNC_NO_QUICKEN to keep the bytecode read-only.
+#ifndef DYNC_NO_QUICKEN
+#define VM_QUICKEN(generic, a, b) (vm -> bytecode[vm -> ip - 1] = quicken_binary((generic), (a), (b), vm -> lazy_vectors))
+#else
+#define VM_QUICKEN(generic, a, b) ((void)0)
+#endif
+
+#define VM_QUICK_BINARY(op, generic, guard, compute) \
+            VM_CASE(op):{ \
+                if (vm -> sp < 2){ \
+                    vm -> bytecode[--vm -> ip] = (generic); \
+                    VM_NEXT(); \
+                } \
+                object_t *rhs = vm -> stack[vm -> sp - 1]; \
+                object_t *lhs = vm -> stack[vm -> sp - 2]; \
+                if (!(guard)){ \
+                    vm -> bytecode[--vm -> ip] = (generic); \
+                    VM_NEXT(); \
+                } \
+                object_t *result = (compute); \
+                if (result == NULL){ \
+                    fprintf(stderr, "VM Error: " #op " Operation failed.\n"); \
+                    return; \
+                } \
+                vm -> stack[vm -> sp - 2] = result; \
+                vm -> sp--; \
+                object_free(lhs); \
+                object_free(rhs); \
+                if (!object_is_immediate(result)){ \
+                    VM_SAFEPOINT(); \
+                } \
+                VM_NEXT(); \
+            }
+
+#define VM_SET_BINARY(op, combine) \
+            VM_CASE(op):{ \
+                VM_SAFEPOINT(); \
+                if (vm -> sp < 2){ \
+                    fprintf(stderr, "VM Error: Stack underflow during " #op ".\n"); \
+                    return; \
+                } \
+                if (!vm_force(vm, 2)){ \
+                    return; \
+                } \
+                object_t *pop1 = vm_pop(vm); \
+                object_t *pop2 = vm_pop(vm); \
+                object_t *result = combine(pop2, pop1); \
+                object_free(pop1); \
+                object_free(pop2); \
+                if (result == NULL){ \
+                    fprintf(stderr, "VM Error: " #op " Operation failed.\n"); \
+                    return; \
+                } \
+                vm_push(vm, result); \
+                VM_NEXT(); \
             }
-        case STRING:
-            fprintf(stderr, "Cannot perform subtraction operation on String kind");
-            return NULL;
 
-        case COLLECTION:
-             if (b -> kind != COLLECTION){
-               fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
-               return NULL;          
+#define VM_VECTOR_REDUCE(op, reduce) \
+            VM_CASE(op):{ \
+                if (vm -> sp == 0){ \
+                    fprintf(stderr, "VM Error: Stack underflow during " #op ".\n"); \
+                    return; \
+                } \
+                if (!vm_force(vm, 1)){ \
+                    return; \
+                } \
+                object_t *operand = vm_pop(vm); \
+                object_t *result = reduce(operand); \
+                object_free(operand); \
+                if (result == NULL){ \
+                    fprintf(stderr, "VM Error: " #op " Operation failed.\n"); \
+                    return; \
+                } \
+                vm_push(vm, result); \
+                VM_NEXT(); \
             }
 
-            if (a -> data.v_collection.stack == false ||b -> data.v_collection.stack == false ){
-               fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
-               return NULL;  
+//Lazy mode: defer vector arithmetic into an expression node if the operands allow
+//it, otherwise make sure neither operand is still an expression before going eager.
+#define VM_TRY_LAZY(arith, a, b, name) \
+                if (vm -> lazy_vectors){ \
+                    object_t *lazy = vector_expr_build((a), (b), (arith)); \
+                    if (lazy != NULL){ \
+                        vm_push(vm, lazy); \
+                        VM_NEXT(); \
+                    } \
+                    if (!force_vector_expr(&(a)) || !force_vector_expr(&(b))){ \
+                        fprintf(stderr, "VM Error: " name " Operation failed.\n"); \
+                        object_free(a); \
+                        object_free(b); \
+                        return; \
+                    } \
+                }
 
-            }
+#define QUICK_INTS (object_kind(lhs) == INTEGER && object_kind(rhs) == INTEGER)
+#define QUICK_FLOATS (object_kind(lhs) == FLOAT && object_kind(rhs) == FLOAT)
+#define QUICK_VEC_SCALAR (object_kind(lhs) == VECTOR && (object_kind(rhs) == INTEGER || object_kind(rhs) == FLOAT) && !vm -> lazy_vectors)
 
-            if (b -> data.v_collection.length >  a -> data.v_collection.length){
-                fprintf(stderr, "Subtraction Underflow error");
-                return NULL;
+static void run_vm_loop(vm_t *vm){
+    printf("--- VM BOOT SEQUENCE INITIATED ---\n");
+#ifdef DYNC_COMPUTED_GOTO
+    static void *const dispatch_table[OP_COUNT] = {
+        [OP_PUSH_INT] = &&do_OP_PUSH_INT,
+        [OP_PUSH_STRING] = &&do_OP_PUSH_STRING,
+        [OP_BUILD_COLLECTION] = &&do_OP_BUILD_COLLECTION,
+        [OP_BUILD_VECTOR] = &&do_OP_BUILD_VECTOR,
+        [OP_ADD] = &&do_OP_ADD,
+        [OP_SUB] = &&do_OP_SUB,
+        [OP_MUL] = &&do_OP_MUL,
+        [OP_DIV] = &&do_OP_DIV,
+        [OP_PRINT] = &&do_OP_PRINT,
+        [OP_HALT] = &&do_OP_HALT,
+        [OP_PUSH_FLOAT] = &&do_OP_PUSH_FLOAT,
+        [OP_ADD_INT_INT] = &&do_OP_ADD_INT_INT,
+        [OP_ADD_FLOAT_FLOAT] = &&do_OP_ADD_FLOAT_FLOAT,
+        [OP_ADD_VEC_SCALAR] = &&do_OP_ADD_VEC_SCALAR,
+        [OP_SUB_INT_INT] = &&do_OP_SUB_INT_INT,
+        [OP_SUB_FLOAT_FLOAT] = &&do_OP_SUB_FLOAT_FLOAT,
+        [OP_SUB_VEC_SCALAR] = &&do_OP_SUB_VEC_SCALAR,
+        [OP_MUL_INT_INT] = &&do_OP_MUL_INT_INT,
+        [OP_MUL_FLOAT_FLOAT] = &&do_OP_MUL_FLOAT_FLOAT,
+        [OP_MUL_VEC_SCALAR] = &&do_OP_MUL_VEC_SCALAR,
+        [OP_DIV_INT_INT] = &&do_OP_DIV_INT_INT,
+        [OP_DIV_FLOAT_FLOAT] = &&do_OP_DIV_FLOAT_FLOAT,
+        [OP_DIV_VEC_SCALAR] = &&do_OP_DIV_VEC_SCALAR,
+        [OP_DOT] = &&do_OP_DOT,
+        [OP_NORM] = &&do_OP_NORM,
+        [OP_SUM] = &&do_OP_SUM,
+        [OP_MIN] = &&do_OP_MIN,
+        [OP_MAX] = &&do_OP_MAX,
+        [OP_AXPY] = &&do_OP_AXPY,
+        [OP_BUILD_MATRIX] = &&do_OP_BUILD_MATRIX,
+        [OP_MATMUL] = &&do_OP_MATMUL,
+        [OP_BUILD_DICT] = &&do_OP_BUILD_DICT,
+        [OP_GET] = &&do_OP_GET,
+        [OP_SET] = &&do_OP_SET,
+        [OP_BUILD_SET] = &&do_OP_BUILD_SET,
+        [OP_CONTAINS] = &&do_OP_CONTAINS,
+        [OP_UNION] = &&do_OP_UNION,
+        [OP_INTERSECT] = &&do_OP_INTERSECT,
+        [OP_DIFFERENCE] = &&do_OP_DIFFERENCE,
+        [OP_SORT] = &&do_OP_SORT,
+        [OP_SLICE] = &&do_OP_SLICE,
+        [OP_BUILD_DEQUE] = &&do_OP_BUILD_DEQUE,
+        [OP_PUSH_BACK] = &&do_OP_PUSH_BACK,
+        [OP_PUSH_FRONT] = &&do_OP_PUSH_FRONT,
+        [OP_POP_BACK] = &&do_OP_POP_BACK,
+        [OP_POP_FRONT] = &&do_OP_POP_FRONT,
+        [OP_BUILD_PLIST] = &&do_OP_BUILD_PLIST,
+    };
+    size_t instruction;
+#ifdef DYNC_DUAL_DISPATCH
+    const bool switch_dispatch = vm_switch_dispatch;
+    VM_NEXT();
+    while(true){
+vm_switch_next:
+        instruction = vm -> bytecode[vm -> ip];
+        vm -> ip++;
+
+        switch(instruction){
+#else
+    VM_NEXT();
+    //stand-ins for the while/switch braces so both builds share one handler body
+    {
+        {
+#endif
+#else
+    while(true){
+        size_t instruction = vm -> bytecode[vm -> ip];
+        vm -> ip++;
+
+        switch(instruction){
+#endif
+            VM_CASE(OP_HALT):
+                //whatever is left on the stack is the program's result, hand back real values
+                vm_force(vm, vm -> sp);
+                printf("--- VM HALTED ----\n");
+                return;
+            VM_CASE(OP_PUSH_INT):{
+                int push_int = vm -> bytecode[vm -> ip];
+                vm -> ip++;
+                object_t *int_obj = new_object_integer(push_int);    
+                vm_push(vm, int_obj);
+                VM_NEXT();
             }
-            for (size_t i = 0; i < b -> data.v_collection.length; i++){
-                object_t *a_test = a -> data.v_collection.data[a -> data.v_collection.length - 1 - i];
-                object_t *b_test = b -> data.v_collection.data[i];
-                if (object_equals(a_test, b_test) == false){
-                    return NULL;
-                }
+            VM_CASE(OP_PUSH_FLOAT):{
+                size_t raw_bits = vm -> bytecode[vm -> ip];
+                vm -> ip++;
+                object_t *float_obj = new_object_float(*(float*)&raw_bits);
+                vm_push(vm, float_obj);
+                VM_NEXT();
             }
-            for (size_t i = 0; i < b -> data.v_collection.length; i++){
-                object_t *popped_item = collection_pop(a);
-                object_free(popped_item);
+            VM_CASE(OP_PUSH_STRING):{
+                VM_SAFEPOINT();
+                size_t raw_bits_string = vm -> bytecode[vm -> ip];
+                vm -> ip++;
+                char * text = (char *)raw_bits_string;
+                //literals are interned, every push of the same text shares one object
+                object_t *string_obj = new_object_string_interned(text, strlen(text));
+                vm_push(vm, string_obj);
+                VM_NEXT();
             }
-            
-            return a;
-         case VECTOR:{
-            switch(b -> kind){
-                case INTEGER:{
-                    float scalar = (float)b -> data.v_int;
-                    float buffer[a -> data.v_vector.dimensions];
-
-                    for (size_t i = 0; i < a -> data.v_vector.dimensions; i++){
-                        buffer[i] = a -> data.v_vector.coords[i] - scalar;
+
+            VM_CASE(OP_BUILD_COLLECTION):{
+                VM_SAFEPOINT();
+                size_t pop_depth = vm -> bytecode[vm -> ip];
+                vm -> ip++;
+
+                if (pop_depth > vm -> sp){
+                    fprintf(stderr, "STACK UNDERFLOW ERROR DURING BUILD PROCESS");
+                    return;
+                }
+                if (!vm_force(vm, pop_depth)){
+                    return;
+                }
+                //all INTEGER or all FLOAT immediates get packed storage
+                uint8_t items = pop_depth > 0 ? collection_items_for(vm -> stack[vm -> sp - pop_depth]) : ITEMS_BOXED;
+                for (size_t i = vm -> sp - pop_depth; items != ITEMS_BOXED && i < vm -> sp; i++){
+                    if (collection_items_for(vm -> stack[i]) != items){
+                        items = ITEMS_BOXED;
+                    }
+                }
+                object_t *new_collection = collection_new(pop_depth > 0 ? pop_depth : 1, false, items);
+                if (new_collection == NULL){
+                    fprintf(stderr, "VM Error: BUILD_COLLECTION allocation failed\n");
+                    return;
+                }
+
+                //the top pop_depth slots are already in push order, move them in one go
+                vm -> sp -= pop_depth;
+                if (items == ITEMS_BOXED){
+                    memcpy(new_collection -> data.v_collection.data, vm -> stack + vm -> sp, sizeof(object_t *) * pop_depth);
+                }
+                else {
+                    for (size_t i = 0; i < pop_depth; i++){
+                        collection_put(new_collection, i, vm -> stack[vm -> sp + i]);
                     }
+                }
+                new_collection -> data.v_collection.length = pop_depth;
 
-                    object_t *new_vector = new_object_vector(a -> data.v_vector.dimensions, buffer);
+                vm_push(vm, new_collection);
+                VM_NEXT();
+            }
+            VM_CASE(OP_BUILD_VECTOR):{
+                VM_SAFEPOINT();
+                size_t d = vm -> bytecode[vm -> ip];
+                vm -> ip++;
 
+                if (d > vm -> sp){
+                    fprintf(stderr, "STACK UNDERFLOW ERROR");
+                    return;
+                }
+                if (!vm_force(vm, d)){
+                    return;
+                }
 
-                    return new_vector;
+                //no VLA here: a computed goto out of its scope never releases the stack space
+                object_t *new_vector = new_object_vector_uninit(d);
+                if (new_vector == NULL){
+                    fprintf(stderr, "VM Error: BUILD_VECTOR allocation failed\n");
+                    return;
                 }
+                float *buffer = new_vector -> data.v_vector.coords;
+                object_t **items = vm -> stack + (vm -> sp - d);
 
-                case FLOAT:{
-                    float scalar = b -> data.v_float;
-                    float buffer[a -> data.v_vector.dimensions];
+                for (size_t i = 0; i < d; i++){
+                    if (object_kind(items[i]) == INTEGER){
+                        buffer[i] = (float)object_int(items[i]);
+                    }
+
+                    else if(object_kind(items[i]) == FLOAT){
+                        buffer[i] = object_float(items[i]);
+                    }
 
-                    for (size_t i = 0; i < a -> data.v_vector.dimensions; i++){
-                        buffer[i] = a -> data.v_vector.coords[i] - scalar;
+                    else {
+                        fprintf(stderr, "Cannot vectorize non-int or non-float kind");
+                        object_free(new_vector);
+                        return;
                     }
+                }
+                for (size_t i = 0; i < d; i++){
+                    object_free(items[i]);
+                }
+                vm -> sp -= d;
+                vm_push(vm, new_vector);
 
-                    object_t *new_vector = new_object_vector(a -> data.v_vector.dimensions, buffer);
+                VM_NEXT();
+
+            }
 
 
-                    return new_vector;
 
+            VM_CASE(OP_ADD):{
+                VM_SAFEPOINT();
+                if (vm -> sp < 2){
+                    fprintf(stderr, "VM Error: Stack underflow during ADD.\n");
+                    return;
                 }
-                case VECTOR:{
-                    if (a -> data.v_vector.dimensions != b -> data.v_vector.dimensions){
-                        fprintf(stderr, "Cannot perform element wise subtraction on vectors in different dimenstions");
-                        object_free(a);
-                        object_free(b);
-                        return NULL;
-                    }
-                    float buffer[a -> data.v_vector.dimensions];
+                object_t *pop1 = vm_pop(vm);
+                object_t *pop2 = vm_pop(vm);
+                VM_TRY_LAZY(ARITH_ADD, pop2, pop1, "ADD")
 
-                    for (size_t i = 0; i < a -> data.v_vector.dimensions; i++){
-                        buffer[i] = a -> data.v_vector.coords[i] - b -> data.v_vector.coords[i];
-                    }
+                object_t *result = object_add(pop2, pop1);
+
+                if (result == NULL){
+                    fprintf(stderr, "VM Error: ADD Operation failed.\n");
+                    object_free(pop1);
+                    object_free(pop2);
+                    return;
+                }
+                VM_QUICKEN(OP_ADD, pop2, pop1);
 
-                    object_t *new_vector = new_object_vector(a -> data.v_vector.dimensions, buffer);
+                vm_push(vm, result);
 
-                    return new_vector;
+                object_free(pop1);
+                object_free(pop2);
 
+                VM_NEXT();
+            }
+            VM_CASE(OP_SUB):{
+                VM_SAFEPOINT();
+                if (vm -> sp < 2){
+                    fprintf(stderr, "VM Error: Stack underflow during SUB.\n");
+                    return;
                 }
-                default:
-                    fprintf(stderr,"Incompatible kinds");
+                object_t *pop1 = vm_pop(vm);
+                object_t *pop2 = vm_pop(vm);
+                VM_TRY_LAZY(ARITH_SUB, pop2, pop1, "SUB")
 
-                    return NULL;
+                object_t *result = object_subtract(pop2, pop1);
 
-            }
-        }
-            
-        default:
-            return NULL;
-    }
-    return NULL;
-}
+                if (result == NULL){
+                    fprintf(stderr, "VM Error: SUB Operation failed.\n");
+                    object_free(pop1);
+                    object_free(pop2);
+                    return;
+                }
+                VM_QUICKEN(OP_SUB, pop2, pop1);
 
+                vm_push(vm, result);
+                object_free(pop1);
+                object_free(pop2);
+
+                VM_NEXT();
 
-object_t *object_multiply(object_t *a, object_t *b){
-    if (a == NULL || b == NULL){
-        fprintf(stderr, "Cannot perform operation on Null data\n");
-        return NULL;
-    }
-    switch(a -> kind){
-        case INTEGER:
-            switch (b -> kind){
-                case INTEGER:
-                    return new_object_integer(a -> data.v_int * b -> data.v_int);
-                case FLOAT:
-                    return new_object_float((float)a -> data.v_int * b -> data.v_float);
-                default:
-                    fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
-                    return NULL;
-            }
-        case FLOAT:
-            switch (b -> kind){
-                case INTEGER:
-                    return new_object_float(a -> data.v_float * (float)b -> data.v_int);
-                case FLOAT:
-                    return new_object_float(a -> data.v_float * b -> data.v_float);
-                default:
-                    fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
-                    return NULL;
-            }
-        case STRING:{
-            if (b -> kind !=  INTEGER || b -> data.v_int <= 0){
-                fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
-                return NULL;  
             }
-            size_t chunk_size = strlen(a -> data.v_string);
-            size_t offset = 0;
-            size_t length =chunk_size * (b -> data.v_int) + 1;
+            VM_CASE(OP_MUL):{
+                VM_SAFEPOINT();
+                if (vm -> sp < 2){
+                    fprintf(stderr, "VM Error: Stack underflow during MUL.\n");
+                    return;
+                }
+                object_t *pop1 = vm_pop(vm);
+                object_t *pop2 = vm_pop(vm);
+                VM_TRY_LAZY(ARITH_MUL, pop2, pop1, "MUL")
 
+                object_t *result = object_multiply(pop2, pop1);
+
+                if (result == NULL){
+                    fprintf(stderr, "VM Error: MUL Operation failed.\n");
+                    object_free(pop1);
+                    object_free(pop2);
+                    return;
+                }
+                VM_QUICKEN(OP_MUL, pop2, pop1);
+
+                vm_push(vm, result);
+
+                object_free(pop1);
+                object_free(pop2);
+
+                VM_NEXT();
 
-            char *new_string = calloc(length, sizeof(char));
-            if(new_string == NULL){
-                return NULL;
-            }
-            for (size_t i = 0; i < b -> data.v_int; i++){
-                 strcpy(new_string + offset, a -> data.v_string);
-                 offset = offset + chunk_size;
             }
+            VM_CASE(OP_DIV):{
+                VM_SAFEPOINT();
+                if (vm -> sp < 2){
+                    fprintf(stderr, "VM Error: Stack underflow during DIV.\n");
+                    return;
+                }
+                object_t *pop1 = vm_pop(vm);
+                object_t *pop2 = vm_pop(vm);
+                VM_TRY_LAZY(ARITH_DIV, pop2, pop1, "DIV")
+
+                object_t *result = object_divide(pop2, pop1);
+
+                if (result == NULL){
+                    fprintf(stderr, "VM Error: DIV Operation failed.\n");
+                    object_free(pop1);
+                    object_free(pop2);
+                    return;
+                }
+                VM_QUICKEN(OP_DIV, pop2, pop1);
+
+                vm_push(vm, result);
+                object_free(pop1);
+                object_free(pop2);
+
+                VM_NEXT();
 
-            object_t *newstring = new_object_string(new_string);
-            free(new_string);
-            return newstring;
-        }
-        case COLLECTION:{
-            if (b -> kind !=  INTEGER || b -> data.v_int <= 0){
-                fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
-                return NULL;  
             }
 
-            size_t cap = a -> data.v_collection.length * b -> data.v_int;
-            object_t *new_collection = new_object_collection(cap, a -> data.v_collection.stack);
+            VM_QUICK_BINARY(OP_ADD_INT_INT, OP_ADD, QUICK_INTS,
+                            new_object_integer(object_int(lhs) + object_int(rhs)))
+            VM_QUICK_BINARY(OP_ADD_FLOAT_FLOAT, OP_ADD, QUICK_FLOATS,
+                            new_object_float(object_float(lhs) + object_float(rhs)))
+            VM_QUICK_BINARY(OP_ADD_VEC_SCALAR, OP_ADD, QUICK_VEC_SCALAR,
+                            vector_scalar_arith(lhs, object_scalar(rhs), ARITH_ADD))
+            VM_QUICK_BINARY(OP_SUB_INT_INT, OP_SUB, QUICK_INTS,
+                            new_object_integer(object_int(lhs) - object_int(rhs)))
+            VM_QUICK_BINARY(OP_SUB_FLOAT_FLOAT, OP_SUB, QUICK_FLOATS,
+                            new_object_float(object_float(lhs) - object_float(rhs)))
+            VM_QUICK_BINARY(OP_SUB_VEC_SCALAR, OP_SUB, QUICK_VEC_SCALAR,
+                            vector_scalar_arith(lhs, object_scalar(rhs), ARITH_SUB))
+            VM_QUICK_BINARY(OP_MUL_INT_INT, OP_MUL, QUICK_INTS,
+                            new_object_integer(object_int(lhs) * object_int(rhs)))
+            VM_QUICK_BINARY(OP_MUL_FLOAT_FLOAT, OP_MUL, QUICK_FLOATS,
+                            new_object_float(object_float(lhs) * object_float(rhs)))
+            VM_QUICK_BINARY(OP_MUL_VEC_SCALAR, OP_MUL, QUICK_VEC_SCALAR,
+                            vector_scalar_arith(lhs, object_scalar(rhs), ARITH_MUL))
+            //zero divisors fail the guard so the generic path reports the error
+            VM_QUICK_BINARY(OP_DIV_INT_INT, OP_DIV, QUICK_INTS && object_int(rhs) != 0,
+                            new_object_integer(object_int(lhs) / object_int(rhs)))
+            VM_QUICK_BINARY(OP_DIV_FLOAT_FLOAT, OP_DIV, QUICK_FLOATS && object_float(rhs) != 0,
+                            new_object_float(object_float(lhs) / object_float(rhs)))
+            VM_QUICK_BINARY(OP_DIV_VEC_SCALAR, OP_DIV, QUICK_VEC_SCALAR && object_scalar(rhs) != 0,
+                            vector_scalar_arith(lhs, object_scalar(rhs), ARITH_DIV))
+
+            VM_CASE(OP_DOT):{
+                if (vm -> sp < 2){
+                    fprintf(stderr, "VM Error: Stack underflow during DOT.\n");
+                    return;
+                }
+                if (!vm_force(vm, 2)){
+                    return;
+                }
+                object_t *pop1 = vm_pop(vm);
+                object_t *pop2 = vm_pop(vm);
+
+                object_t *result = vector_dot(pop2, pop1);
+                object_free(pop1);
+                object_free(pop2);
 
-            for (size_t i = 0; i < b -> data.v_int; i++){
-                for (size_t j =0; j < a -> data.v_collection.length; j++){
-                    collection_append(new_collection, object_clone(a -> data.v_collection.data[j]));
+                if (result == NULL){
+                    fprintf(stderr, "VM Error: DOT Operation failed.\n");
+                    return;
                 }
+                vm_push(vm, result);
+                VM_NEXT();
             }
-            return new_collection;
-        }
+            VM_VECTOR_REDUCE(OP_NORM, vector_norm)
+            VM_VECTOR_REDUCE(OP_SUM, vector_sum)
+            VM_VECTOR_REDUCE(OP_MIN, vector_min)
+            VM_VECTOR_REDUCE(OP_MAX, vector_max)
+            VM_CASE(OP_AXPY):{
+                VM_SAFEPOINT();
+                if (vm -> sp < 3){
+                    fprintf(stderr, "VM Error: Stack underflow during AXPY.\n");
+                    return;
+                }
+                if (!vm_force(vm, 3)){
+                    return;
+                }
+                object_t *y = vm_pop(vm);
+                object_t *x = vm_pop(vm);
+                object_t *alpha = vm_pop(vm);
 
-         case VECTOR:{
-            switch(b -> kind){
-                case INTEGER:{
-                    float scalar = (float)b -> data.v_int;
-                    float buffer[a -> data.v_vector.dimensions];
+                object_t *result = vector_axpy(alpha, x, y);
+                object_free(y);
+                object_free(x);
+                object_free(alpha);
 
-                    for (size_t i = 0; i < a -> data.v_vector.dimensions; i++){
-                        buffer[i] = a -> data.v_vector.coords[i] * scalar;
-                    }
+                if (result == NULL){
+                    fprintf(stderr, "VM Error: AXPY Operation failed.\n");
+                    return;
+                }
+                vm_push(vm, result);
+                VM_NEXT();
+            }
 
-                    object_t *new_vector = new_object_vector(a -> data.v_vector.dimensions, buffer);
+            VM_CASE(OP_BUILD_MATRIX):{
+                VM_SAFEPOINT();
+                size_t rows = vm -> bytecode[vm -> ip];
+                vm -> ip++;
 
-                    return new_vector;
+                if (rows == 0 || rows > vm -> sp){
+                    fprintf(stderr, "STACK UNDERFLOW ERROR DURING BUILD PROCESS");
+                    return;
+                }
+                if (!vm_force(vm, rows)){
+                    return;
                 }
 
-                case FLOAT:{
-                    float scalar = b -> data.v_float;
-                    float buffer[a -> data.v_vector.dimensions];
-
-                    for (size_t i = 0; i < a -> data.v_vector.dimensions; i++){
-                        buffer[i] = a -> data.v_vector.coords[i] * scalar;
+                object_t **items = vm -> stack + (vm -> sp - rows);
+                for (size_t i = 0; i < rows; i++){
+                    if (object_kind(items[i]) != VECTOR || items[i] -> data.v_vector.dimensions != items[0] -> data.v_vector.dimensions){
+                        fprintf(stderr, "Cannot build matrix from rows that are not vectors of equal dimensions");
+                        return;
                     }
+                }
 
-                    object_t *new_vector = new_object_vector(a -> data.v_vector.dimensions, buffer);
+                size_t cols = items[0] -> data.v_vector.dimensions;
+                object_t *new_matrix = new_object_matrix_uninit(rows, cols);
+                if (new_matrix == NULL){
+                    fprintf(stderr, "VM Error: BUILD_MATRIX allocation failed\n");
+                    return;
+                }
+                for (size_t i = 0; i < rows; i++){
+                    memcpy(new_matrix -> data.v_matrix.values + i * cols, items[i] -> data.v_vector.coords, sizeof(float) * cols);
+                    object_free(items[i]);
+                }
+                vm -> sp -= rows;
+                vm_push(vm, new_matrix);
+                VM_NEXT();
+            }
 
+            VM_CASE(OP_MATMUL):{
+                VM_SAFEPOINT();
+                if (vm -> sp < 2){
+                    fprintf(stderr, "VM Error: Stack underflow during MATMUL.\n");
+                    return;
+                }
+                if (!vm_force(vm, 2)){
+                    return;
+                }
+                object_t *pop1 = vm_pop(vm);
+                object_t *pop2 = vm_pop(vm);
 
-                    return new_vector;
+                object_t *result = matrix_multiply(pop2, pop1);
+                object_free(pop1);
+                object_free(pop2);
 
+                if (result == NULL){
+                    fprintf(stderr, "VM Error: MATMUL Operation failed.\n");
+                    return;
                 }
-                case VECTOR:{
-                    if (a -> data.v_vector.dimensions != b -> data.v_vector.dimensions){
-                        fprintf(stderr, "Cannot perform element wise multiplication on vectors in different dimenstions");
+                vm_push(vm, result);
+                VM_NEXT();
+            }
 
-                        return NULL;
-                    }
-                    float buffer[a -> data.v_vector.dimensions];
+            VM_CASE(OP_BUILD_DICT):{
+                VM_SAFEPOINT();
+                size_t pairs = vm -> bytecode[vm -> ip];
+                vm -> ip++;
 
-                    for (size_t i = 0; i < a -> data.v_vector.dimensions; i++){
-                        buffer[i] = a -> data.v_vector.coords[i] * b -> data.v_vector.coords[i];
+                if (pairs > vm -> sp / 2){
+                    fprintf(stderr, "STACK UNDERFLOW ERROR DURING BUILD PROCESS");
+                    return;
+                }
+                if (!vm_force(vm, pairs * 2)){
+                    return;
+                }
+                object_t *new_dict = new_object_dict(pairs);
+                if (new_dict == NULL){
+                    fprintf(stderr, "VM Error: BUILD_DICT allocation failed\n");
+                    return;
+                }
+                //pairs are pushed key first, a repeated key keeps its last value
+                vm -> sp -= pairs * 2;
+                object_t **items = vm -> stack + vm -> sp;
+                for (size_t i = 0; i < pairs; i++){
+                    if (dict_set(new_dict, items[2 * i], items[2 * i + 1]) != 0){
+                        fprintf(stderr, "VM Error: BUILD_DICT Operation failed.\n");
+                        for (size_t j = 2 * i; j < pairs * 2; j++){
+                            object_free(items[j]);
+                        }
+                        object_free(new_dict);
+                        return;
                     }
+                }
+                vm_push(vm, new_dict);
+                VM_NEXT();
+            }
 
-                    object_t *new_vector = new_object_vector(a -> data.v_vector.dimensions, buffer);
-
-                    return new_vector;
-
+            VM_CASE(OP_GET):{
+                if (vm -> sp < 2){
+                    fprintf(stderr, "VM Error: Stack underflow during GET.\n");
+                    return;
                 }
-                default:
-                    fprintf(stderr,"Incompatible kinds");
+                if (!vm_force(vm, 2)){
+                    return;
+                }
+                object_t *key = vm_pop(vm);
+                object_t *container = vm_pop(vm);
 
-                    return NULL;
+                object_t *value = NULL;
+                if (object_kind(container) == DICT){
+                    value = dict_get(container, key);
+                }
+                else if (object_kind(container) == COLLECTION && object_kind(key) == INTEGER && object_int(key) >= 0){
+                    value = collection_access(container, (size_t)object_int(key));
+                }
+                else if (object_kind(container) == PLIST && object_kind(key) == INTEGER && object_int(key) >= 0){
+                    value = plist_get(container, (size_t)object_int(key));
+                }
+                //the value outlives its container on the stack
+                object_retain(value);
+                object_free(key);
+                object_free(container);
 
+                if (value == NULL){
+                    fprintf(stderr, "VM Error: GET Operation failed.\n");
+                    return;
+                }
+                vm_push(vm, value);
+                VM_NEXT();
             }
-        }
-            
-        default:
-            return NULL;
-    }
-}
 
-object_t *object_divide(object_t *a, object_t *b){
-    if (a == NULL || b == NULL){
-        fprintf(stderr, "Cannot perform operation on Null data\n");
-        return NULL;
-    }
-    switch(a -> kind){
-        case INTEGER:
-            switch (b -> kind){
-                case INTEGER:
-                    if (b -> data.v_int == 0){
-                        fprintf(stderr, "VM ERROR: Division by zero");
-                        return NULL;
-                    }
-                    return new_object_integer(a -> data.v_int / b -> data.v_int);
-                case FLOAT:
-                    if (b -> data.v_float == 0){
-                        fprintf(stderr, "VM ERROR: Division by zero");
-                        return NULL;
+            VM_CASE(OP_SET):{
+                VM_SAFEPOINT();
+                if (vm -> sp < 3){
+                    fprintf(stderr, "VM Error: Stack underflow during SET.\n");
+                    return;
+                }
+                if (!vm_force(vm, 3)){
+                    return;
+                }
+                object_t *value = vm_pop(vm);
+                object_t *key = vm_pop(vm);
+                object_t *container = vm_pop(vm);
+
+                //a container someone else still holds is copied, not changed under them
+                if (!object_is_immediate(container) && REFCOUNT_LOAD(container -> refcount) > 1 &&
+                    (object_kind(container) == DICT || object_kind(container) == COLLECTION)){
+                    object_t *own = object_clone(container);
+                    object_free(container);
+                    container = own;
+                }
+                int status = -1;
+                if (container != NULL && object_kind(container) == DICT){
+                    status = dict_set(container, key, value);
+                    if (status == 0){
+                        key = NULL;
+                        value = NULL;
                     }
-                    return new_object_float((float)a -> data.v_int / b -> data.v_float);
-                default:
-                    fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
-                    return NULL;
-            }
-        case FLOAT:
-            switch (b -> kind){
-                case INTEGER:
-                    if (b -> data.v_int == 0){
-                        fprintf(stderr, "VM ERROR: Division by zero");
-                        return NULL;
+                }
+                else if (container != NULL && object_kind(container) == COLLECTION && object_kind(key) == INTEGER && object_int(key) >= 0){
+                    status = collection_set(container, (size_t)object_int(key), value);
+                    if (status == 0){
+                        value = NULL;
                     }
-                    return new_object_float(a -> data.v_float / (float)b -> data.v_int);
-                case FLOAT:
-                    if (b -> data.v_float == 0){
-                        fprintf(stderr, "VM ERROR: Division by zero");
-                        return NULL;
+                }
+                else if (container != NULL && object_kind(container) == PLIST && object_kind(key) == INTEGER && object_int(key) >= 0){
+                    //a new version, the old one stays as it is for whoever else holds it
+                    object_t *version = plist_set(container, (size_t)object_int(key), value);
+                    if (version != NULL){
+                        object_free(container);
+                        container = version;
+                        value = NULL;
+                        status = 0;
                     }
-                    return new_object_float(a -> data.v_float / b -> data.v_float);
-                default:
-                    fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
-                    return NULL;
+                }
+                object_free(key);
+                object_free(value);
+
+                if (status != 0){
+                    fprintf(stderr, "VM Error: SET Operation failed.\n");
+                    object_free(container);
+                    return;
+                }
+                vm_push(vm, container);
+                VM_NEXT();
             }
-         case VECTOR:{
-            switch(b -> kind){
-                case INTEGER:{
-                    if (b -> data.v_int == 0){
-                        fprintf(stderr, "Division by zero error");
 
-                        return NULL;
-                    }
-                    float scalar = (float)b -> data.v_int;
-                    float buffer[a -> data.v_vector.dimensions];
+            VM_CASE(OP_BUILD_SET):{
+                VM_SAFEPOINT();
+                size_t count = vm -> bytecode[vm -> ip];
+                vm -> ip++;
 
-                    for (size_t i = 0; i < a -> data.v_vector.dimensions; i++){
-                        buffer[i] = a -> data.v_vector.coords[i] / scalar;
+                if (count > vm -> sp){
+                    fprintf(stderr, "STACK UNDERFLOW ERROR DURING BUILD PROCESS");
+                    return;
+                }
+                if (!vm_force(vm, count)){
+                    return;
+                }
+                object_t *new_set = new_object_set(count);
+                if (new_set == NULL){
+                    fprintf(stderr, "VM Error: BUILD_SET allocation failed\n");
+                    return;
+                }
+                vm -> sp -= count;
+                object_t **items = vm -> stack + vm -> sp;
+                for (size_t i = 0; i < count; i++){
+                    if (set_add(new_set, items[i]) < 0){
+                        fprintf(stderr, "VM Error: BUILD_SET Operation failed.\n");
+                        for (size_t j = i; j < count; j++){
+                            object_free(items[j]);
+                        }
+                        object_free(new_set);
+                        return;
                     }
+                }
+                vm_push(vm, new_set);
+                VM_NEXT();
+            }
 
-                    object_t *new_vector = new_object_vector(a -> data.v_vector.dimensions, buffer);
+            VM_CASE(OP_CONTAINS):{
+                if (vm -> sp < 2){
+                    fprintf(stderr, "VM Error: Stack underflow during CONTAINS.\n");
+                    return;
+                }
+                if (!vm_force(vm, 2)){
+                    return;
+                }
+                object_t *item = vm_pop(vm);
+                object_t *container = vm_pop(vm);
+
+                int found = -1;
+                switch (object_kind(container)){
+                    case SET:
+                        found = set_contains(container, item);
+                        break;
+                    case DICT:
+                        found = dict_get(container, item) != NULL;
+                        break;
+                    case COLLECTION:
+                        found = collection_contains(container, item);
+                        break;
+                    default:
+                        break;
+                }
+                object_free(item);
+                object_free(container);
 
-                    return new_vector;
+                if (found < 0){
+                    fprintf(stderr, "VM Error: CONTAINS Operation failed.\n");
+                    return;
                 }
+                vm_push(vm, new_object_integer(found));
+                VM_NEXT();
+            }
 
-                case FLOAT:{
-                    if (b -> data.v_float == 0.0){
-                        fprintf(stderr, "Division by zero error");
+            VM_SET_BINARY(OP_UNION, set_union)
+            VM_SET_BINARY(OP_INTERSECT, set_intersection)
+            VM_SET_BINARY(OP_DIFFERENCE, set_difference)
 
-                        return NULL;
-                    }
-                    float scalar = b -> data.v_float;
-                    float buffer[a -> data.v_vector.dimensions];
+            VM_CASE(OP_SORT):{
+                VM_SAFEPOINT();
+                if (vm -> sp == 0){
+                    fprintf(stderr, "VM Error: Stack underflow during SORT.\n");
+                    return;
+                }
+                object_t *target = vm_pop(vm);
+                //sort a private header, the item array itself is copy-on-write
+                if (object_kind(target) == COLLECTION && REFCOUNT_LOAD(target -> refcount) > 1){
+                    object_t *own = collection_share(target);
+                    object_free(target);
+                    target = own;
+                }
+                if (target == NULL || collection_sort(target) != 0){
+                    fprintf(stderr, "VM Error: SORT Operation failed.\n");
+                    object_free(target);
+                    return;
+                }
+                vm_push(vm, target);
+                VM_NEXT();
+            }
 
-                    for (size_t i = 0; i < a -> data.v_vector.dimensions; i++){
-                        buffer[i] = a -> data.v_vector.coords[i] / scalar;
-                    }
+            VM_CASE(OP_SLICE):{
+                VM_SAFEPOINT();
+                if (vm -> sp < 3){
+                    fprintf(stderr, "VM Error: Stack underflow during SLICE.\n");
+                    return;
+                }
+                if (!vm_force(vm, 3)){
+                    return;
+                }
+                object_t *length = vm_pop(vm);
+                object_t *start = vm_pop(vm);
+                object_t *target = vm_pop(vm);
 
-                    object_t *new_vector = new_object_vector(a -> data.v_vector.dimensions, buffer);
+                object_t *view = NULL;
+                if (object_kind(start) == INTEGER && object_kind(length) == INTEGER && object_int(start) >= 0 && object_int(length) >= 0){
+                    view = object_slice(target, (size_t)object_int(start), (size_t)object_int(length));
+                }
+                object_free(length);
+                object_free(start);
+                object_free(target);
 
+                if (view == NULL){
+                    fprintf(stderr, "VM Error: SLICE Operation failed.\n");
+                    return;
+                }
+                vm_push(vm, view);
+                VM_NEXT();
+            }
 
-                    return new_vector;
+            VM_CASE(OP_BUILD_DEQUE):{
+                VM_SAFEPOINT();
+                size_t count = vm -> bytecode[vm -> ip];
+                vm -> ip++;
 
+                if (count > vm -> sp){
+                    fprintf(stderr, "STACK UNDERFLOW ERROR DURING BUILD PROCESS");
+                    return;
                 }
-                case VECTOR:{
-                    if (a -> data.v_vector.dimensions != b -> data.v_vector.dimensions){
-                        fprintf(stderr, "Cannot perform element wise division on vectors in different dimenstions");
-                        return NULL;
-                    }
-                    for (size_t j = 0; j < a -> data.v_vector.dimensions; j++){
-                        if (b -> data.v_vector.coords[j] == 0.0){
-                            fprintf(stderr, "Division by zero error");
-                            return NULL;
-                        }
-                    }
-                    float buffer[a -> data.v_vector.dimensions];
+                if (!vm_force(vm, count)){
+                    return;
+                }
+                object_t *new_deque = new_object_deque(count);
+                if (new_deque == NULL){
+                    fprintf(stderr, "VM Error: BUILD_DEQUE allocation failed\n");
+                    return;
+                }
+                //sized up front, the pushes cannot fail
+                vm -> sp -= count;
+                for (size_t i = 0; i < count; i++){
+                    deque_push_back(new_deque, vm -> stack[vm -> sp + i]);
+                }
+                vm_push(vm, new_deque);
+                VM_NEXT();
+            }
 
-                    for (size_t i = 0; i < a -> data.v_vector.dimensions; i++){
-                        buffer[i] = a -> data.v_vector.coords[i] / b -> data.v_vector.coords[i];
+            VM_CASE(OP_PUSH_BACK):
+            VM_CASE(OP_PUSH_FRONT):{
+                VM_SAFEPOINT();
+                bool front = instruction == OP_PUSH_FRONT;
+                if (vm -> sp < 2){
+                    fprintf(stderr, "VM Error: Stack underflow during PUSH.\n");
+                    return;
+                }
+                if (!vm_force(vm, 2)){
+                    return;
+                }
+                object_t *item = vm_pop(vm);
+                object_t *target = vm_pop(vm);
+
+                if (object_kind(target) == PLIST && !front){
+                    //the list itself never changes, the new version replaces it on the stack
+                    object_t *version = plist_append(target, item);
+                    object_free(target);
+                    if (version == NULL){
+                        fprintf(stderr, "VM Error: PUSH Operation failed.\n");
+                        object_free(item);
+                        return;
                     }
-
-                    object_t *new_vector = new_object_vector(a -> data.v_vector.dimensions, buffer);
-                    return new_vector;
-
+                    vm_push(vm, version);
+                    VM_NEXT();
                 }
-                default:
-                    fprintf(stderr,"Incompatible kinds");
-                    return NULL;
-
+                //a deque someone else still holds is copied, not changed under them
+                if (object_kind(target) == DEQUE && REFCOUNT_LOAD(target -> refcount) > 1){
+                    object_t *own = deque_copy(target);
+                    object_free(target);
+                    target = own;
+                }
+                if (target == NULL || (front ? deque_push_front(target, item) : deque_push_back(target, item)) != 0){
+                    fprintf(stderr, "VM Error: PUSH Operation failed.\n");
+                    object_free(item);
+                    object_free(target);
+                    return;
+                }
+                vm_push(vm, target);
+                VM_NEXT();
             }
-        }
-            
-        case STRING:
-            fprintf(stderr, "Cannot perform division operation on string kind");
-            return NULL;
-        case COLLECTION:
-            fprintf(stderr, "Cannot perform division operation on Collection kind");
-            return NULL;
-
-        default:
-            fprintf(stderr, "Cannot perform operation on incompatible kinds\n");
-            return NULL;    
-
-    }
-}
-
-
 
+            VM_CASE(OP_POP_BACK):
+            VM_CASE(OP_POP_FRONT):{
+                VM_SAFEPOINT();
+                bool front = instruction == OP_POP_FRONT;
+                if (vm -> sp == 0){
+                    fprintf(stderr, "VM Error: Stack underflow during POP.\n");
+                    return;
+                }
+                object_t *target = vm_pop(vm);
+                if (object_kind(target) == DEQUE && REFCOUNT_LOAD(target -> refcount) > 1){
+                    object_t *own = deque_copy(target);
+                    object_free(target);
+                    target = own;
+                }
+                object_t *item = target == NULL ? NULL : (front ? deque_pop_front(target) : deque_pop_back(target));
+                if (item == NULL){
+                    fprintf(stderr, "VM Error: POP Operation failed.\n");
+                    object_free(target);
+                    return;
+                }
+                vm_push(vm, target);
+                vm_push(vm, item);
+                VM_NEXT();
+            }
 
-void print_object(object_t *obj1){
-    if (obj1 == NULL){
-        printf("NULL");
-        return;
-    }
+            VM_CASE(OP_BUILD_PLIST):{
+                VM_SAFEPOINT();
+                size_t count = vm -> bytecode[vm -> ip];
+                vm -> ip++;
 
-    switch(obj1 -> kind){
-        case INTEGER:
-            printf("%d", obj1 -> data.v_int);
-            break;
-        case FLOAT:
-            printf("%f", obj1 -> data.v_float);
-            break;
-        case STRING:
-            printf("%s", obj1 -> data.v_string);
-            break;
-        case COLLECTION:
-            printf("[");
-            for (size_t i = 0; i < obj1 -> data.v_collection.length; i++){
-                print_object(obj1 -> data.v_collection.data[i]);
-                if (i < obj1 -> data.v_collection.length - 1){
-                      printf(", ");
+                if (count > vm -> sp){
+                    fprintf(stderr, "STACK UNDERFLOW ERROR DURING BUILD PROCESS");
+                    return;
                 }
-
+                if (!vm_force(vm, count)){
+                    return;
+                }
+                vm -> sp -= count;
+                //the leaves retain the items, the stack references go afterwards
+                plist_node_t *root = count > 0 ? plist_build(&vm -> stack[vm -> sp], count) : NULL;
+                object_t *new_plist = count == 0 || root != NULL ? plist_wrap(root) : NULL;
+                for (size_t i = 0; i < count; i++){
+                    object_free(vm -> stack[vm -> sp + i]);
+                }
+                if (new_plist == NULL){
+                    fprintf(stderr, "VM Error: BUILD_PLIST allocation failed\n");
+                    return;
+                }
+                vm_push(vm, new_plist);
+                VM_NEXT();
             }
-            printf("]\n");
-            break;
-        case VECTOR:
-            printf("<");
-            for (size_t j = 0; j < obj1 -> data.v_vector.dimensions; j++){
-                printf("%f", obj1 -> data.v_vector.coords[j]);
-                if (j < obj1 -> data.v_vector.dimensions - 1){
-                    printf(",");
+
+            VM_CASE(OP_PRINT):{
+                if (vm -> sp == 0){
+                    fprintf(stderr, "VM Error: Stack underflow during PRINT\n");
+                    return;
+                }
+                if (!vm_force(vm, 1)){
+                    return;
                 }
+                object_t *stack_top = vm_pop(vm);
+                print_object(stack_top);
+                printf("\n");
+                object_free(stack_top);
+                VM_NEXT();
             }
-            printf(">\n");
-            break;
-    }
+            VM_DEFAULT:
+                fprintf(stderr, "Unknown Virtual Machine OP_CODE");
+                return;
 
-}
+        }
 
-void print_collection_data(object_t *obj){
-    if (obj -> kind != COLLECTION){
-        fprintf(stderr, "Cannot print data of non_collection kind");
-        return;
     }
-
-    printf("Collection capacity: %zu\n", obj -> data.v_collection.capacity);
-    printf("Number of items in collection: %zu\n", obj -> data.v_collection.length);
-
 }
 
-
-int is_full(object_t *obj){
-    if (obj -> kind != COLLECTION){
-        fprintf(stderr, "Object of non_collection kind cannot be empty");
-        return -1;
+void run_vm(vm_t *vm){
+    if (vm == NULL || vm -> bytecode == NULL || vm -> stack == NULL){
+        fprintf(stderr, "[NULL ERROR] VM cannot run on null parameters\n");
+        return;
+    }
+    if (gc_enabled && !gc_register_vm(vm)){
+        fprintf(stderr, "VM Error: cannot register the operand stack as a collector root\n");
+        return;
+    }
+    if (vm -> arena == NULL){
+        run_vm_loop(vm);
+        return;
     }
+    object_arena_t *outer = object_arena_activate(vm -> arena);
+    run_vm_loop(vm);
+    object_arena_activate(outer);
 
-    if(obj -> data.v_collection.length == obj -> data.v_collection.capacity){
-        return 1;
+    //the results escape, everything else goes with the region
+    for (size_t i = 0; i < vm -> sp; i++){
+        vm -> stack[i] = object_promote(vm -> stack[i]);
     }
-    return 0;
+    object_arena_reset(vm -> arena);
+}
 
+#undef VM_SAFEPOINT
+#undef VM_CASE
+#undef VM_DEFAULT
+#undef VM_NEXT
+#undef VM_QUICKEN
+#undef VM_QUICK_BINARY
+#undef VM_VECTOR_REDUCE
+#undef VM_TRY_LAZY
+#undef VM_SET_BINARY
+#undef QUICK_INTS
+#undef QUICK_FLOATS
+#undef QUICK_VEC_SCALAR
+
+#ifdef DYNC_BENCH
+// ======= BENCHMARKS =======
+// Build with: gcc -O2 -DDYNC_BENCH -o dyn_bench objects.c -lm -pthread
+// Run all benchmarks with ./dyn_bench, or pass benchmark names to pick some.
+
+static double bench_now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
 }
 
-vm_t *new_virtual_machine(size_t *code){
-    vm_t *vm = malloc(sizeof(vm_t));
-    if (vm == NULL){
-        fprintf(stderr, "Memory allocation failed");
+//PUSH_INT 1, then 'ops' x (PUSH_INT i, ADD), then HALT. Caller frees the result.
+static size_t *bench_arithmetic_program(size_t ops){
+    size_t *code = malloc(sizeof(size_t) * (ops * 3 + 3));
+    if (code == NULL){
         return NULL;
     }
+    size_t n = 0;
+    code[n++] = OP_PUSH_INT;
+    code[n++] = 1;
+    for (size_t i = 0; i < ops; i++){
+        code[n++] = OP_PUSH_INT;
+        code[n++] = i & 0xff;
+        code[n++] = OP_ADD;
+    }
+    code[n++] = OP_HALT;
+    return code;
+}
 
-    vm -> ip = 0;
-    vm -> bytecode = code;
-
-    vm -> operand_stack = new_object_collection(256, true);
+static size_t bench_float_operand(float value){
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
 
-    if (vm -> operand_stack == NULL){
-        free(vm);
+//A running sum of 3D vectors, a BUILD_VECTOR and an ADD per op: with immediate
+//ints and floats this is the VM loop that still allocates an object per step
+static size_t *bench_small_vector_program(size_t ops){
+    size_t *code = malloc(sizeof(size_t) * (ops * 9 + 9));
+    if (code == NULL){
         return NULL;
     }
+    size_t n = 0;
+    for (int i = 0; i < 3; i++){
+        code[n++] = OP_PUSH_FLOAT;
+        code[n++] = bench_float_operand(0.0f);
+    }
+    code[n++] = OP_BUILD_VECTOR;
+    code[n++] = 3;
+    for (size_t i = 0; i < ops; i++){
+        code[n++] = OP_PUSH_FLOAT;
+        code[n++] = bench_float_operand(1.0f);
+        code[n++] = OP_PUSH_FLOAT;
+        code[n++] = bench_float_operand(2.0f);
+        code[n++] = OP_PUSH_INT;
+        code[n++] = 3;
+        code[n++] = OP_BUILD_VECTOR;
+        code[n++] = 3;
+        code[n++] = OP_ADD;
+    }
+    code[n++] = OP_HALT;
+    return code;
+}
 
-    return vm;
+static double bench_run_program(size_t *code){
+    vm_t *vm = new_virtual_machine(code);
+    if (vm == NULL){
+        return 0;
+    }
+    double start = bench_now_ns();
+    run_vm(vm);
+    double elapsed = bench_now_ns() - start;
+    free_virtual_machine(vm);
+    return elapsed;
 }
 
-void run_vm(vm_t *vm){
-    if (vm == NULL || vm -> bytecode == NULL || vm -> operand_stack == NULL){
-        fprintf(stderr, "[NULL ERROR] VM cannot run on null parameters\n");
+//Slab against malloc on a loop allocating two vector headers per op. The
+//PUSH_INT/ADD stream allocates nothing since ints became immediates.
+static void bench_slab_vs_malloc(void){
+    const size_t ops = 1000000;
+    const int reps = 5;
+    size_t *code = bench_small_vector_program(ops);
+    if (code == NULL){
         return;
     }
-    printf("--- VM BOOT SEQUENCE INITIATED ---\n");
-    while(true){
-        size_t instruction = vm -> bytecode[vm -> ip];
-        vm -> ip++;
-
-        switch(instruction){
-            case OP_HALT:
-                printf("--- VM HALTED ----\n");
-                return;
-            case OP_PUSH_INT:{
-                int push_int = vm -> bytecode[vm -> ip];
-                vm -> ip++;
-                object_t *int_obj = new_object_integer(push_int);    
-                collection_append(vm -> operand_stack, int_obj);
-                break;
-            }
-            case OP_PUSH_FLOAT:{
-                size_t raw_bits = vm -> bytecode[vm -> ip];
-                vm -> ip++;
-                object_t *float_obj = new_object_float(*(float*)&raw_bits);
-                collection_append(vm -> operand_stack, float_obj);
-                break;
-            }
-            case OP_PUSH_STRING:{
-                size_t raw_bits_string = vm -> bytecode[vm -> ip];
-                vm -> ip++;
-                char * text = (char *)raw_bits_string;
-                object_t *string_obj = new_object_string(text);
-                collection_append(vm -> operand_stack, string_obj);
-                break;
+    for (int mode = 0; mode < 2; mode++){
+        allocator_set_slab_enabled(mode == 0);
+        allocator_reset_stats();
+        double best = 0;
+        for (int r = 0; r < reps; r++){
+            double t = bench_run_program(code);
+            if (r == 0 || t < best){
+                best = t;
             }
+        }
+        allocator_stats_t stats = allocator_stats();
+        printf("[slab] %-6s %8.2f ms  %6.2f ns/op  allocations: %zu  malloc calls: %zu\n",
+               mode == 0 ? "slab" : "malloc", best / 1e6, best / ops,
+               stats.allocations, stats.fallback_allocations + stats.slab_refills);
+    }
+    allocator_set_slab_enabled(true);
+    free(code);
+}
 
-            case OP_BUILD_COLLECTION:{
-                size_t pop_depth = vm -> bytecode[vm -> ip];
-                vm -> ip++;
-
-                if (pop_depth > vm -> operand_stack -> data.v_collection.length){
-                    fprintf(stderr, "STACK UNDERFLOW ERROR DURING BUILD PROCESS");
-                    return;
-                }
-                object_t *new_collection = new_object_collection(pop_depth, false);
-                object_t *buffer[pop_depth];
+//Dispatch cost per instruction on a long PUSH_INT/ADD stream, threaded against
+//switch dispatch on the same build (only the switch loop without computed goto).
+static void bench_dispatch(void){
+    const size_t ops = 2000000;
+    const int reps = 7;
+    size_t *code = bench_arithmetic_program(ops);
+    if (code == NULL){
+        return;
+    }
+    size_t instructions = ops * 2 + 2;
+#ifdef DYNC_DUAL_DISPATCH
+    const int modes = 2;
+#else
+    const int modes = 1;
+#endif
+    for (int m = 0; m < modes; m++){
+#ifdef DYNC_DUAL_DISPATCH
+        vm_switch_dispatch = m == 1;
+        const char *mode = m == 1 ? "switch" : "threaded";
+#else
+        const char *mode = "switch";
+#endif
+        double best = 0;
+        for (int r = 0; r < reps; r++){
+            double t = bench_run_program(code);
+            if (r == 0 || t < best){
+                best = t;
+            }
+        }
+        printf("[dispatch] %-8s %zu instructions  %8.2f ms  %5.2f ns/instruction\n",
+               mode, instructions, best / 1e6, best / instructions);
+    }
+#ifdef DYNC_DUAL_DISPATCH
+    vm_switch_dispatch = false;
+#endif
+    free(code);
+}
 
-                for (size_t i = 0; i < pop_depth; i++){
-                    buffer[i] = collection_pop(vm -> operand_stack);
+//Element-wise vector kernels per instruction set across dimension sizes.
+//Every result is compared against the scalar kernels.
+static void bench_simd(void){
+    static const char *const isas[] = {"scalar", "sse", "avx2", "avx512"};
+    static const char *const op_names[] = {"add", "sub", "mul", "div"};
+    const size_t sizes[] = {4, 64, 1024, 16384, 262144, 4194304};
+    const size_t work = 1 << 26; //elements processed per measurement
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++){
+        size_t n = sizes[s];
+        float *a_coords = malloc(sizeof(float) * n);
+        float *b_coords = malloc(sizeof(float) * n);
+        if (a_coords == NULL || b_coords == NULL){
+            free(a_coords);
+            free(b_coords);
+            return;
+        }
+        for (size_t i = 0; i < n; i++){
+            a_coords[i] = (float)(i % 97) * 0.25f - 3.0f;
+            b_coords[i] = (float)(i % 13) + 0.5f;
+        }
+        object_t *a = new_object_vector(n, a_coords);
+        object_t *b = new_object_vector(n, b_coords);
+        object_t *scalar = new_object_float(1.75f);
+
+        for (int op = ARITH_ADD; op <= ARITH_DIV; op++){
+            vector_simd_select("scalar");
+            object_t *expected_vv = vector_vector_arith(a, b, (arith_op_t)op);
+            object_t *expected_vs = vector_scalar_arith(a, object_float(scalar), (arith_op_t)op);
+
+            printf("[simd] %-3s n=%-8zu", op_names[op], n);
+            for (size_t k = 0; k < sizeof(isas) / sizeof(isas[0]); k++){
+                if (!vector_simd_select(isas[k])){
+                    continue;
                 }
-
-                for (size_t j = 0; j < pop_depth ; j++){
-                    collection_append(new_collection, buffer[(pop_depth - 1) - j]);
+                size_t reps = work / n > 0 ? work / n : 1;
+                double start = bench_now_ns();
+                for (size_t r = 0; r < reps; r++){
+                    object_free(vector_vector_arith(a, b, (arith_op_t)op));
                 }
-
-                collection_append(vm -> operand_stack, new_collection);
-                break;
+                double elapsed = bench_now_ns() - start;
+
+                object_t *got_vv = vector_vector_arith(a, b, (arith_op_t)op);
+                object_t *got_vs = vector_scalar_arith(a, object_float(scalar), (arith_op_t)op);
+                bool match = memcmp(got_vv -> data.v_vector.coords, expected_vv -> data.v_vector.coords, sizeof(float) * n) == 0
+                          && memcmp(got_vs -> data.v_vector.coords, expected_vs -> data.v_vector.coords, sizeof(float) * n) == 0;
+                object_free(got_vv);
+                object_free(got_vs);
+                printf("  %s %6.3f ns/elem%s", isas[k], elapsed / ((double)reps * n), match ? "" : " MISMATCH");
             }
-            case OP_BUILD_VECTOR:{
-                size_t d = vm -> bytecode[vm -> ip];
-                vm -> ip++;
-
-                float buffer[d];
-
-                for (size_t i = 0; i < d; i++){
-                    object_t *popped_item = collection_pop(vm -> operand_stack);
+            printf("\n");
+            object_free(expected_vv);
+            object_free(expected_vs);
+        }
+        object_free(a);
+        object_free(b);
+        object_free(scalar);
+        free(a_coords);
+        free(b_coords);
+    }
+    vector_simd_select(NULL);
+}
 
-                    if (popped_item == NULL){
-                        fprintf(stderr, "STACK UNDERFLOW ERROR");
-                        return;
+//Square matmul GFLOPS: the naive i-j-k triple loop against the blocked SIMD kernel
+static void bench_matmul(void){
+    const size_t sizes[] = {64, 256, 512, 1024};
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++){
+        size_t n = sizes[s];
+        float *a = malloc(sizeof(float) * n * n);
+        float *b = malloc(sizeof(float) * n * n);
+        float *naive = malloc(sizeof(float) * n * n);
+        if (a == NULL || b == NULL || naive == NULL){
+            free(a);
+            free(b);
+            free(naive);
+            return;
+        }
+        for (size_t i = 0; i < n * n; i++){
+            a[i] = (float)(i % 17) * 0.125f - 1.0f;
+            b[i] = (float)(i % 23) * 0.0625f - 0.5f;
+        }
+        object_t *ma = new_object_matrix(n, n, a);
+        object_t *mb = new_object_matrix(n, n, b);
+        double flops = 2.0 * n * n * n;
+        int reps = n <= 256 ? 10 : 1;
+
+        double start = bench_now_ns();
+        for (int r = 0; r < reps; r++){
+            for (size_t i = 0; i < n; i++){
+                for (size_t j = 0; j < n; j++){
+                    float total = 0.0f;
+                    for (size_t k = 0; k < n; k++){
+                        total += a[i * n + k] * b[k * n + j];
                     }
+                    naive[i * n + j] = total;
+                }
+            }
+        }
+        double naive_ns = (bench_now_ns() - start) / reps;
 
-                    else if (popped_item -> kind == INTEGER){
-                        buffer[d - 1 - i] = (float)popped_item -> data.v_int;
-                    }
+        object_t *blocked = NULL;
+        start = bench_now_ns();
+        for (int r = 0; r < reps; r++){
+            object_free(blocked);
+            blocked = matrix_multiply(ma, mb);
+        }
+        double blocked_ns = (bench_now_ns() - start) / reps;
 
-                    else if(popped_item -> kind == FLOAT){
-                        buffer[d - 1 - i] = (float)popped_item -> data.v_float;
+        float max_error = 0.0f;
+        for (size_t i = 0; i < n * n; i++){
+            float error = fabsf(blocked -> data.v_matrix.values[i] - naive[i]);
+            max_error = error > max_error ? error : max_error;
+        }
+        printf("[matmul] n=%-5zu naive %7.2f GFLOPS  blocked(%s) %7.2f GFLOPS  max |diff| %g\n",
+               n, flops / naive_ns, vector_simd_name(), flops / blocked_ns, max_error);
+
+        object_free(blocked);
+        object_free(ma);
+        object_free(mb);
+        free(a);
+        free(b);
+        free(naive);
+    }
+}
 
-                    }
+//OP_BUILD_VECTOR + OP_ADD on 3D vectors, with inline coords against a separate buffer per vector
+static void bench_small_vectors(void){
+    const size_t ops = 500000;
+    const int reps = 5;
+    size_t *code = bench_small_vector_program(ops);
+    if (code == NULL){
+        return;
+    }
 
-                    else {
-                        fprintf(stderr, "Cannot vectorize non-int or non-float kind");
-                        return;
-                    }
+    for (int mode = 0; mode < 2; mode++){
+        vector_set_inline_limit(mode == 0 ? VECTOR_INLINE_MAX : 0);
+        double best = 0;
+        allocator_stats_t stats = {0};
+        for (int r = 0; r < reps; r++){
+            allocator_reset_stats();
+            double t = bench_run_program(code);
+            if (r == 0 || t < best){
+                best = t;
+            }
+            stats = allocator_stats();
+        }
+        printf("[small_vectors] %-7s %8.2f ms  %6.2f ns/(build+add)  allocations: %zu (headers %zu, coords %zu)\n",
+               mode == 0 ? "inline" : "heap", best / 1e6, best / ops,
+               stats.allocations + stats.payload_allocations, stats.allocations, stats.payload_allocations);
+    }
+    vector_set_inline_limit(VECTOR_INLINE_MAX);
+    free(code);
+}
 
-                    object_free(popped_item);
+//Batch script churning through 16D vectors (header + coords buffer each), heap against arena mode
+static void bench_arena(void){
+    const size_t ops = 2000; //per script, so a run's region stays cache sized
+    const size_t runs = 200;
+    const size_t dims = 16;
+    const int reps = 5;
+    size_t *code = malloc(sizeof(size_t) * ((ops + 1) * (dims * 2 + 3) + 1));
+    if (code == NULL){
+        return;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < dims; i++){
+        code[n++] = OP_PUSH_FLOAT;
+        code[n++] = bench_float_operand(0.0f);
+    }
+    code[n++] = OP_BUILD_VECTOR;
+    code[n++] = dims;
+    for (size_t i = 0; i < ops; i++){
+        for (size_t j = 0; j < dims; j++){
+            code[n++] = OP_PUSH_FLOAT;
+            code[n++] = bench_float_operand((float)j);
+        }
+        code[n++] = OP_BUILD_VECTOR;
+        code[n++] = dims;
+        code[n++] = OP_ADD;
+    }
+    code[n++] = OP_HALT;
 
-                    
+    for (int mode = 0; mode < 2; mode++){
+        //one VM per mode, so arena mode gets to reuse its region from the second run on
+        vm_t *vm = new_virtual_machine(code);
+        if (vm == NULL || !vm_set_arena(vm, mode == 1)){
+            free_virtual_machine(vm);
+            break;
+        }
+        double best = 0;
+        for (int r = 0; r < reps; r++){
+            double start = bench_now_ns();
+            for (size_t k = 0; k < runs; k++){
+                vm -> ip = 0;
+                run_vm(vm);
+                while (vm -> sp > 0){
+                    object_free(vm_pop(vm));
                 }
-                collection_append(vm -> operand_stack, new_object_vector(d, buffer));
-
-                break;
-
             }
+            double t = bench_now_ns() - start;
+            if (r == 0 || t < best){
+                best = t;
+            }
+        }
+        printf("[arena] %-5s %8.2f ms  %6.2f ns/(build+add)", mode == 0 ? "heap" : "arena", best / 1e6, best / (ops * runs));
+        if (mode == 1){
+            printf("  region high-water %.1f MB", vm -> arena -> peak_bytes / (1024.0 * 1024.0));
+        }
+        printf("\n");
+        free_virtual_machine(vm);
+    }
+    free(code);
+}
 
+//One long script churning through 16D vectors, reference counting against the tracing collector
+static void bench_gc(void){
+    const size_t ops = 200000;
+    const size_t dims = 16;
+    size_t *code = malloc(sizeof(size_t) * ((ops + 1) * (dims * 2 + 3) + 1));
+    if (code == NULL){
+        return;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < dims; i++){
+        code[n++] = OP_PUSH_FLOAT;
+        code[n++] = bench_float_operand(0.0f);
+    }
+    code[n++] = OP_BUILD_VECTOR;
+    code[n++] = dims;
+    for (size_t i = 0; i < ops; i++){
+        for (size_t j = 0; j < dims; j++){
+            code[n++] = OP_PUSH_FLOAT;
+            code[n++] = bench_float_operand((float)j);
+        }
+        code[n++] = OP_BUILD_VECTOR;
+        code[n++] = dims;
+        code[n++] = OP_ADD;
+    }
+    code[n++] = OP_HALT;
+
+    double refcounted = bench_run_program(code);
+    gc_set_enabled(true);
+    gc_reset_stats();
+    double collected = bench_run_program(code);
+    gc_collect();
+    gc_set_enabled(false);
+    printf("[gc] refcount %8.2f ms  %6.2f ns/(build+add)\n", refcounted / 1e6, refcounted / ops);
+    printf("[gc] tracing  %8.2f ms  %6.2f ns/(build+add)\n", collected / 1e6, collected / ops);
+    print_gc_stats();
+    free(code);
+}
 
+static double bench_build_string(size_t bytes){
+    object_t *piece = new_object_string("x");
+    object_t *text = new_object_string("");
+    double start = bench_now_ns();
+    for (size_t i = 0; i < bytes && text != NULL; i++){
+        object_t *longer = object_add(text, piece);
+        object_free(text);
+        text = longer;
+    }
+    double elapsed = bench_now_ns() - start;
+    if (text == NULL || object_length(text) != (int)bytes || string_flatten(text) == NULL){
+        printf("[rope] build of %zu bytes FAILED\n", bytes);
+    }
+    object_free(text);
+    object_free(piece);
+    return elapsed;
+}
 
-            case OP_ADD:{
-                object_t *pop1 = collection_pop(vm -> operand_stack);
-                object_t *pop2 = collection_pop(vm -> operand_stack);
-                
-                if(pop1 == NULL || pop2 == NULL){
-                    fprintf(stderr, "VM Error: Stack underflow during ADD.\n");
-                    object_free(pop1);
-                    object_free(pop2);
-                    return;                   
-                }
-
-                object_t *result = object_add(pop2, pop1);
-
-                if (result == NULL){
-                    fprintf(stderr, "VM Error: ADD Operation failed.\n");
-                    object_free(pop1);
-                    object_free(pop2);
-                    return;
-                }
+//Repeated 1-byte OP_ADD concatenation, flat strings against ropes
+static void bench_rope(void){
+    const size_t flat_sizes[] = {16384, 65536, 262144};
+    for (size_t i = 0; i < sizeof(flat_sizes) / sizeof(flat_sizes[0]); i++){
+        string_set_rope_threshold(SIZE_MAX);
+        double flat = bench_build_string(flat_sizes[i]);
+        string_set_rope_threshold(512);
+        double rope = bench_build_string(flat_sizes[i]);
+        printf("[rope] %8zu bytes  flat %9.2f ms  rope %7.2f ms\n", flat_sizes[i], flat / 1e6, rope / 1e6);
+    }
+    size_t big = (size_t)10 << 20;
+    double rope = bench_build_string(big);
+    printf("[rope] %8zu bytes  flat (skipped, quadratic)  rope %7.2f ms  %5.2f ns/append\n", big, rope / 1e6, rope / big);
+}
 
-                collection_append(vm -> operand_stack, result);
+//Allocator bytes held by 'count' live boxed INTEGERs of 'size' bytes, as read from the allocator's counters
+static size_t bench_boxed_bytes(size_t count, size_t size){
+    object_t **boxes = malloc(sizeof(object_t *) * count);
+    if (boxes == NULL){
+        return 0;
+    }
+    allocator_reset_stats();
+    for (size_t i = 0; i < count; i++){
+        boxes[i] = object_new(size, INTEGER);
+        if (boxes[i] != NULL){
+            boxes[i] -> data.v_int = (int)i;
+        }
+    }
+    allocator_stats_t stats = allocator_stats();
+    size_t bytes = stats.bytes_allocated - stats.bytes_freed;
+    for (size_t i = 0; i < count; i++){
+        object_dealloc(boxes[i], size);
+    }
+    free(boxes);
+    return bytes;
+}
 
-                object_free(pop1);
-                object_free(pop2);
+//A heap INTEGER, the way new_object_integer makes one when immediates are off
+static object_t *bench_boxed_int(int value){
+    object_t *box = object_new(OBJECT_SIZE_OF(v_int), INTEGER);
+    if (box != NULL){
+        box -> data.v_int = value;
+    }
+    return box;
+}
 
-                break;
-            }
-            case OP_SUB:{
-                object_t *pop1 = collection_pop(vm -> operand_stack);
-                object_t *pop2 = collection_pop(vm -> operand_stack);
-                
-                if(pop1 == NULL || pop2 == NULL){
-                    fprintf(stderr, "VM Error: Stack underflow during SUB.\n");
-                    object_free(pop1);
-                    object_free(pop2);
-                    return;                   
-                }
+//Fills 'ints' with 'count' integers, boxed on the heap or from new_object_integer,
+//then reports its memory and a summing pass through collection_access
+static void bench_int_collection(const char *label, object_t *ints, size_t count, bool boxed){
+    allocator_reset_stats();
+    double start = bench_now_ns();
+    for (size_t i = 0; i < count && ints != NULL; i++){
+        object_t *item = boxed ? bench_boxed_int((int)i) : new_object_integer((int)i);
+        if (collection_append(ints, item) != 0){
+            object_free(item);
+            break;
+        }
+    }
+    double elapsed = bench_now_ns() - start;
+    if (ints == NULL || object_length(ints) != (int)count){
+        printf("[footprint] build of %zu ints FAILED\n", count);
+        object_free(ints);
+        return;
+    }
+    //the collection header was made before the reset, and stores come from plain malloc
+    allocator_stats_t stats = allocator_stats();
+    size_t items = stats.bytes_allocated - stats.bytes_freed;
+    double sum_start = bench_now_ns();
+    long long sum = 0;
+    for (size_t i = 0; i < count; i++){
+        sum += object_int(collection_access(ints, i));
+    }
+    double summing = bench_now_ns() - sum_start;
+    size_t store = sizeof(size_t) + ints -> data.v_collection.capacity * collection_item_size(ints -> data.v_collection.items);
+    printf("[footprint] %-9s %zu ints  %7.1f MB  %5.2f bytes/element (store %.1f MB, item objects %.1f MB)  %5.2f ns/append  %5.2f ns/item sum (%lld)\n",
+           label, count, (store + items) / 1e6, (double)(store + items) / count, store / 1e6, items / 1e6,
+           elapsed / count, summing / count, sum);
+    object_free(ints);
+}
 
-                object_t *result = object_subtract(pop2, pop1);
+//Memory held by a 10M-element int collection, with heap INTEGER items, immediates
+//and packed, plus boxed scalars at the compact and the full object_t size. Item
+//memory comes from the allocator's byte counters, the store from its capacity.
+static void bench_footprint(void){
+    const size_t count = 10000000;
+    bench_int_collection("boxed", new_object_collection(16, false), count, true);
+#ifdef DYNC_IMMEDIATES
+    bench_int_collection("immediate", new_object_collection(16, false), count, false);
+#endif
+    bench_int_collection("typed", new_object_typed_collection(16, false, INTEGER), count, false);
+
+    size_t compact = bench_boxed_bytes(count, OBJECT_SIZE_OF(v_int));
+    size_t full = bench_boxed_bytes(count, sizeof(object_t));
+    printf("[footprint] boxed INTEGER  compact %2zu bytes -> %7.1f MB   full object_t %2zu bytes -> %7.1f MB\n",
+           OBJECT_SIZE_OF(v_int), compact / 1e6, sizeof(object_t), full / 1e6);
+}
 
-                if (result == NULL){
-                    fprintf(stderr, "VM Error: SUB Operation failed.\n");
-                    object_free(pop1);
-                    object_free(pop2);
-                    return;
-                }
+//Keeps benchmark results observable so the loops computing them are not optimized away
+static volatile long long bench_sink;
 
-                collection_append(vm -> operand_stack, result);
-                object_free(pop1);
-                object_free(pop2);
+//Linear scan over a collection of [key, value] pairs, the way lookups were done before DICT
+static object_t *bench_pairs_lookup(object_t *pairs, object_t *key){
+    for (size_t i = 0; i < pairs -> data.v_collection.length; i++){
+        object_t *pair = collection_item(pairs, i);
+        if (object_equals(collection_item(pair, 0), key)){
+            return collection_item(pair, 1);
+        }
+    }
+    return NULL;
+}
 
-                break;
+//Integer key lookups in a DICT against a linear scan over a collection of pairs
+static void bench_dict(void){
+    const size_t sizes[] = {16, 256, 4096, 65536};
+    const size_t lookups = 1000000;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++){
+        size_t n = sizes[s];
+        object_t *dict = new_object_dict(n);
+        object_t *pairs = new_object_collection(n, false);
+        for (size_t i = 0; i < n && dict != NULL && pairs != NULL; i++){
+            dict_set(dict, new_object_integer((int)(i * 7)), new_object_integer((int)i));
+            object_t *pair = new_object_collection(2, false);
+            collection_append(pair, new_object_integer((int)(i * 7)));
+            collection_append(pair, new_object_integer((int)i));
+            collection_append(pairs, pair);
+        }
+        if (dict == NULL || pairs == NULL || object_length(dict) != (int)n){
+            printf("[dict] build of %zu keys FAILED\n", n);
+            object_free(dict);
+            object_free(pairs);
+            return;
+        }
+        //the scan is O(n), keep its total work bounded
+        size_t scans = lookups / n > 1000 ? lookups : lookups * 16 / n + 100;
+        long long check = 0;
+        double start = bench_now_ns();
+        for (size_t i = 0; i < lookups; i++){
+            object_t *key = new_object_integer((int)((i * 2654435761u) % n * 7));
+            check += object_int(dict_get(dict, key));
+            object_free(key);
+        }
+        double hashed = bench_now_ns() - start;
+        long long check_scan = 0;
+        start = bench_now_ns();
+        for (size_t i = 0; i < scans; i++){
+            object_t *key = new_object_integer((int)((i * 2654435761u) % n * 7));
+            check_scan += object_int(bench_pairs_lookup(pairs, key));
+            object_free(key);
+        }
+        double scanned = bench_now_ns() - start;
+        bench_sink = check + check_scan;
+        printf("[dict] %6zu keys  dict %7.2f ns/lookup  linear scan %10.2f ns/lookup\n", n, hashed / lookups, scanned / scans);
+        object_free(dict);
+        object_free(pairs);
+    }
+}
 
-            }
-            case OP_MUL:{
-                object_t *pop1 = collection_pop(vm -> operand_stack);
-                object_t *pop2 = collection_pop(vm -> operand_stack);
-                
-                if(pop1 == NULL || pop2 == NULL){
-                    fprintf(stderr, "VM Error: Stack underflow during MUL.\n");
-                    object_free(pop1);
-                    object_free(pop2);
-                    return;                   
-                }
+//Membership tests on a 100k-element list, scanning it against a SET built from it once, plus collection_unique
+static void bench_set(void){
+    const size_t n = 100000;
+    const size_t lookups = 1000000;
+    const size_t scans = 2000;
+    object_t *list = new_object_collection(n, false);
+    for (size_t i = 0; i < n && list != NULL; i++){
+        //strings, so neither side gets the packed-int shortcut
+        char text[32];
+        snprintf(text, sizeof(text), "item-%zu", i % (n / 2));
+        collection_append(list, new_object_string(text));
+    }
+    double start = bench_now_ns();
+    object_t *set = collection_to_set(list);
+    double build = bench_now_ns() - start;
+    if (list == NULL || set == NULL || object_length(set) != (int)(n / 2)){
+        printf("[set] build FAILED\n");
+        object_free(list);
+        object_free(set);
+        return;
+    }
+    object_t *probes[64];
+    for (size_t i = 0; i < 64; i++){
+        char text[32];
+        snprintf(text, sizeof(text), "item-%zu", (i * 7919) % n);
+        probes[i] = new_object_string(text);
+    }
+    long long found = 0;
+    start = bench_now_ns();
+    for (size_t i = 0; i < scans; i++){
+        found += collection_contains(list, probes[i % 64]);
+    }
+    double scanned = bench_now_ns() - start;
+    start = bench_now_ns();
+    for (size_t i = 0; i < lookups; i++){
+        found += set_contains(set, probes[i % 64]);
+    }
+    double hashed = bench_now_ns() - start;
+    start = bench_now_ns();
+    object_t *unique = collection_unique(list);
+    double dedup = bench_now_ns() - start;
+    bench_sink = found + object_length(unique);
+    printf("[set] %zu items  collection_contains %9.2f ns  set_contains %6.2f ns  (set built in %.2f ms)\n",
+           n, scanned / scans, hashed / lookups, build / 1e6);
+    printf("[set] collection_unique of %zu items  %7.2f ms\n", n, dedup / 1e6);
+    for (size_t i = 0; i < 64; i++){
+        object_free(probes[i]);
+    }
+    object_free(unique);
+    object_free(set);
+    object_free(list);
+}
 
-                object_t *result = object_multiply(pop2, pop1);
+static void bench_sort(void){
+    const size_t sizes[] = {1000000, 10000000};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++){
+        size_t n = sizes[s];
+        object_t *typed = new_object_typed_collection(n, false, INTEGER);
+        object_t *boxed = new_object_collection(n, false);
+        object_t **generic = malloc(sizeof(object_t *) * n);
+        uint64_t state = 0x2545f4914f6cdd1dULL + n;
+        for (size_t i = 0; i < n && typed != NULL && boxed != NULL; i++){
+            state = hash_mix(state);
+            int value = (int)(uint32_t)state;
+            collection_append(typed, new_object_integer(value));
+            collection_append(boxed, new_object_integer(value));
+        }
+        if (typed == NULL || boxed == NULL || generic == NULL){
+            printf("[sort] setup FAILED\n");
+            object_free(typed);
+            object_free(boxed);
+            free(generic);
+            return;
+        }
+        memcpy(generic, boxed -> data.v_collection.data, sizeof(object_t *) * n);
+
+        double start = bench_now_ns();
+        collection_sort(typed);
+        double radix_typed = bench_now_ns() - start;
+        start = bench_now_ns();
+        collection_sort(boxed);
+        double radix_boxed = bench_now_ns() - start;
+        start = bench_now_ns();
+        object_sort(generic, n);
+        double comparison = bench_now_ns() - start;
+
+        bool ordered = true;
+        for (size_t i = 1; i < n; i++){
+            ordered = ordered && object_compare(generic[i - 1], generic[i]) <= 0
+                              && object_int(collection_item(typed, i)) == object_int(generic[i])
+                              && object_int(collection_item(boxed, i)) == object_int(generic[i]);
+        }
+        bench_sink = ordered;
+        printf("[sort] %8zu ints  radix (packed) %8.2f ms  radix (boxed) %8.2f ms  introsort %8.2f ms  %s\n",
+               n, radix_typed / 1e6, radix_boxed / 1e6, comparison / 1e6, ordered ? "" : "MISMATCH");
+        free(generic);
+        object_free(boxed);
+        object_free(typed);
+    }
+}
 
-                if (result == NULL){
-                    fprintf(stderr, "VM Error: MUL Operation failed.\n");
-                    object_free(pop1);
-                    object_free(pop2);
-                    return;
+static void bench_slice(void){
+    const size_t n = 1000000;
+    const size_t window = 4096;
+    const size_t stride = 256;
+    float *coords = malloc(sizeof(float) * n);
+    object_t *list = new_object_collection(n, false);
+    for (size_t i = 0; coords != NULL && list != NULL && i < n; i++){
+        coords[i] = (float)(i % 1000);
+        //strings, so copying a window has per-item work like any boxed item
+        collection_append(list, new_object_string_n("item", 4));
+    }
+    object_t *vec = coords != NULL ? new_object_vector(n, coords) : NULL;
+    if (vec == NULL || list == NULL){
+        printf("[slice] setup FAILED\n");
+        free(coords);
+        object_free(vec);
+        object_free(list);
+        return;
+    }
+    size_t windows = (n - window) / stride + 1;
+    long long total = 0;
+    for (int mode = 0; mode < 2; mode++){
+        double start = bench_now_ns();
+        for (size_t w = 0; w < windows; w++){
+            object_t *part = mode == 0 ? new_object_vector(window, vec -> data.v_vector.coords + w * stride) : object_slice(vec, w * stride, window);
+            total += (long long)part -> data.v_vector.coords[window - 1];
+            object_free(part);
+        }
+        double vectors = bench_now_ns() - start;
+        start = bench_now_ns();
+        for (size_t w = 0; w < windows; w++){
+            object_t *part;
+            if (mode == 0){
+                part = new_object_collection(window, false);
+                for (size_t i = 0; i < window; i++){
+                    collection_append(part, object_clone(collection_access(list, w * stride + i)));
                 }
+            }
+            else {
+                part = object_slice(list, w * stride, window);
+            }
+            total += object_length(part);
+            object_free(part);
+        }
+        double lists = bench_now_ns() - start;
+        printf("[slice] %-5s %zu windows of %zu  vector %9.2f ns/window  list %9.2f ns/window\n",
+               mode == 0 ? "copy" : "view", windows, window, vectors / windows, lists / windows);
+    }
+    bench_sink = total;
+    free(coords);
+    object_free(vec);
+    object_free(list);
+}
 
-                collection_append(vm -> operand_stack, result);
+static void bench_deque(void){
+    const size_t sizes[] = {1000, 10000, 50000};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++){
+        size_t n = sizes[s];
+        long long total = 0;
+        //work queue: fill it, then take every item off the front
+        double start = bench_now_ns();
+        object_t *list = new_object_collection(n, false);
+        for (size_t i = 0; list != NULL && i < n; i++){
+            collection_append(list, new_object_integer((int)i));
+        }
+        while (list != NULL && list -> data.v_collection.length > 0){
+            object_t *item = object_retain(collection_access(list, 0));
+            collection_splice(list, 0, 1, NULL);
+            total += object_int(item);
+            object_free(item);
+        }
+        double shifted = bench_now_ns() - start;
+        object_free(list);
 
-                object_free(pop1);
-                object_free(pop2);
+        start = bench_now_ns();
+        object_t *queue = new_object_deque(0);
+        for (size_t i = 0; queue != NULL && i < n; i++){
+            deque_push_back(queue, new_object_integer((int)i));
+        }
+        while (queue != NULL && queue -> data.v_deque.length > 0){
+            object_t *item = deque_pop_front(queue);
+            total += object_int(item);
+            object_free(item);
+        }
+        double ring = bench_now_ns() - start;
+        object_free(queue);
 
-                break;
+        bench_sink = total;
+        printf("[deque] %6zu items  collection front removal %9.2f ns/item  deque %6.2f ns/item\n",
+               n, shifted / n, ring / n);
+    }
+}
 
-            }
-            case OP_DIV:{
-                object_t *pop1 = collection_pop(vm -> operand_stack);
-                object_t *pop2 = collection_pop(vm -> operand_stack);
-                
-                if(pop1 == NULL || pop2 == NULL){
-                    fprintf(stderr, "VM Error: Stack underflow during DIV.\n");
-                    object_free(pop1);
-                    object_free(pop2);
-                    return;                   
-                }
+static void bench_plist(void){
+    const size_t sizes[] = {1000, 10000, 100000};
+    const size_t edits = 1000;
+    object_t **history = malloc(sizeof(object_t *) * (edits + 1));
+    for (size_t s = 0; history != NULL && s < sizeof(sizes) / sizeof(sizes[0]); s++){
+        size_t n = sizes[s];
+        object_t *base = new_object_collection(n, false);
+        for (size_t i = 0; base != NULL && i < n; i++){
+            collection_append(base, new_object_integer((int)i));
+        }
+        //undo history: every edit is a new version, all of them are kept
+        double start = bench_now_ns();
+        history[0] = object_clone(base);
+        for (size_t e = 1; e <= edits; e++){
+            history[e] = object_clone(history[e - 1]);
+            collection_set(history[e], (e * 7919) % n, new_object_integer((int)e));
+        }
+        double copied = bench_now_ns() - start;
+        for (size_t e = 0; e <= edits; e++){
+            object_free(history[e]);
+        }
 
-                object_t *result = object_divide(pop2, pop1);
+        start = bench_now_ns();
+        history[0] = plist_from_collection(base);
+        for (size_t e = 1; e <= edits; e++){
+            history[e] = plist_set(history[e - 1], (e * 7919) % n, new_object_integer((int)e));
+        }
+        double shared = bench_now_ns() - start;
+        bench_sink = object_length(history[edits]);
+        for (size_t e = 0; e <= edits; e++){
+            object_free(history[e]);
+        }
 
-                if (result == NULL){
-                    fprintf(stderr, "VM Error: DIV Operation failed.\n");
-                    object_free(pop1);
-                    object_free(pop2);
-                    return;
-                }
+        //snapshots of a growing log
+        start = bench_now_ns();
+        history[0] = object_clone(base);
+        for (size_t e = 1; e <= edits; e++){
+            history[e] = object_clone(history[e - 1]);
+            collection_append(history[e], new_object_integer((int)e));
+        }
+        double copied_append = bench_now_ns() - start;
+        for (size_t e = 0; e <= edits; e++){
+            object_free(history[e]);
+        }
 
-                collection_append(vm -> operand_stack, result);
-                object_free(pop1);
-                object_free(pop2);
+        start = bench_now_ns();
+        history[0] = plist_from_collection(base);
+        for (size_t e = 1; e <= edits; e++){
+            history[e] = plist_append(history[e - 1], new_object_integer((int)e));
+        }
+        double shared_append = bench_now_ns() - start;
+        bench_sink = object_length(history[edits]);
+        for (size_t e = 0; e <= edits; e++){
+            object_free(history[e]);
+        }
 
-                break;
+        //joining two halves, the collection copies both
+        object_t *tree = plist_from_collection(base);
+        start = bench_now_ns();
+        for (size_t e = 0; e < edits; e++){
+            object_free(object_add(base, base));
+        }
+        double copied_concat = bench_now_ns() - start;
+        start = bench_now_ns();
+        for (size_t e = 0; e < edits; e++){
+            object_free(object_add(tree, tree));
+        }
+        double shared_concat = bench_now_ns() - start;
+        object_free(tree);
+        object_free(base);
 
-            }
+        printf("[plist] %6zu items  set: clone+set %9.2f ns  plist %7.2f ns | append: clone+append %9.2f ns  plist %7.2f ns | concat: collection %9.2f ns  plist %7.2f ns\n",
+               n, copied / edits, shared / edits, copied_append / edits, shared_append / edits, copied_concat / edits, shared_concat / edits);
+    }
+    free(history);
+}
 
-            case OP_PRINT:{
-                object_t *stack_top = collection_pop(vm -> operand_stack);
-                if(stack_top == NULL){
-                    fprintf(stderr, "VM Error: Stack underflow during PRINT\n");
-                    return;
-                }
-                print_object(stack_top);
-                printf("\n");
-                object_free(stack_top);
-                break;
+typedef struct {
+    const char *name;
+    void (*run)(void);
+} bench_t;
+
+static const bench_t benchmarks[] = {
+    {"slab", bench_slab_vs_malloc},
+    {"dispatch", bench_dispatch},
+    {"simd", bench_simd},
+    {"matmul", bench_matmul},
+    {"small_vectors", bench_small_vectors},
+    {"rope", bench_rope},
+    {"arena", bench_arena},
+    {"gc", bench_gc},
+    {"footprint", bench_footprint},
+    {"dict", bench_dict},
+    {"set", bench_set},
+    {"sort", bench_sort},
+    {"slice", bench_slice},
+    {"deque", bench_deque},
+    {"plist", bench_plist},
+};
+
+int main(int argc, char **argv){
+    size_t count = sizeof(benchmarks) / sizeof(benchmarks[0]);
+    for (size_t i = 0; i < count; i++){
+        bool selected = argc < 2;
+        for (int j = 1; j < argc; j++){
+            if (strcmp(argv[j], benchmarks[i].name) == 0){
+                selected = true;
             }
-            default:
-                fprintf(stderr, "Unknown Virtual Machine OP_CODE");
-                return;
-
         }
-
+        if (selected){
+            benchmarks[i].run();
+        }
     }
+    return 0;
 }
 
+#else
+
 int main(){
     float f1 = 10.0f;
     float f2 = 20.0f;
@@ -1317,8 +7732,7 @@ int main(){
 
    vm_t *vm_test =  new_virtual_machine(opcodes);
    run_vm(vm_test);
-   object_free(vm_test -> operand_stack);
-   free(vm_test);
+   free_virtual_machine(vm_test);
 
    return 0;
 
@@ -1326,3 +7740,4 @@ int main(){
 
 }
 
+#endif